@@ -13,8 +13,10 @@
 
 #include "nlohmann/json.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <thread>
 #include <unistd.h>
 /**
  * @class ServerConfiguration
@@ -27,16 +29,92 @@ public:
     int getPort() const;
     int getMaxConnection() const;
     std::string getIp() const;
+    size_t getWriteHighWatermark() const;
+    int getWriteTimeout() const;
+    int getMaxClients() const;
+    int getMaxInFlight() const;
+    int getAdmissionWait() const;
+    int getHeaderTimeout() const;
+    int getBodyTimeout() const;
+    int getIdleTimeout() const;
+    int getDrainTimeout() const;
+    int getAcceptors() const;
+    const std::string &getUnixPath() const;
+    int getDedupCacheSize() const;
+    const std::string &getCapturePath() const;
+    int getSelectWeight() const;
+    int getMaxSelectWorkers() const;
 
     /*Setters*/
     void setPort(int port);
     void setIp(const std::string &ip);
     void setMaxConnection(int maxConnection);
+    void setWriteHighWatermark(size_t writeHighWatermark);
+    void setWriteTimeout(int writeTimeout);
+    void setMaxClients(int maxClients);
+    void setMaxInFlight(int maxInFlight);
+    void setAdmissionWait(int admissionWait);
+    void setHeaderTimeout(int headerTimeout);
+    void setBodyTimeout(int bodyTimeout);
+    void setIdleTimeout(int idleTimeout);
+    void setDrainTimeout(int drainTimeout);
+    void setAcceptors(int acceptors);
+    void setUnixPath(const std::string &unixPath);
+    void setDedupCacheSize(int dedupCacheSize);
+    void setCapturePath(const std::string &capturePath);
+    void setSelectWeight(int selectWeight);
+    void setMaxSelectWorkers(int maxSelectWorkers);
 
 private:
     int port;
     std::string ip;
     int maxConnection;
+
+    /*Pending output (bytes) of a client above which the server stops producing more*/
+    size_t writeHighWatermark = 1024 * 1024;
+
+    /*Milliseconds a client may refuse data before it is closed*/
+    int writeTimeout = 30000;
+
+    /*Max connected clients , more connections are rejected as busy*/
+    int maxClients = 64;
+
+    /*Max requests queued or being processed at the same time*/
+    int maxInFlight = 32;
+
+    /*Milliseconds a request waits for a free in-flight slot before it is rejected*/
+    int admissionWait = 1000;
+
+    /*
+     * Read deadlines in milliseconds (0 -> no deadline) :
+     * header -> to send the 15 digits of data length after the prompt.
+     * body -> to send the whole data after its length.
+     * idle -> to answer the continue prompt after a result.
+     */
+    int headerTimeout = 30000;
+    int bodyTimeout = 60000;
+    int idleTimeout = 60000;
+
+    /*Milliseconds a shutdown waits for queued and in-flight requests*/
+    int drainTimeout = 10000;
+
+    /*Listening sockets (SO_REUSEPORT) with one accepting thread each*/
+    int acceptors = 1;
+
+    /*Path of an AF_UNIX listener for local clients (empty -> no unix listener)*/
+    std::string unixPath;
+
+    /*Recently stored payloads answered without parsing when sent again (0 -> disabled)*/
+    int dedupCacheSize = 4096;
+
+    /*File to which every request body is appended for dbm-replay (empty -> no capture)*/
+    std::string capturePath;
+
+    /*Inserts taken from the queue before a select when both kinds of requests wait*/
+    int selectWeight = 4;
+
+    /*Workers that process selects at the same time (0 -> no limit)*/
+    int maxSelectWorkers = 2;
 };
 
 /**
@@ -48,13 +126,177 @@ class DatabaseConfiguration
 public:
     /*Getters*/
     std::string getFilePath() const;
+    bool getIdempotent() const;
 
     /*Setters*/
     void setFilePath(const std::string &filePath);
+    void setIdempotent(bool idempotent);
 
 private:
     std::string filePath;
+
+    /*A document whose uuid is already stored is acknowledged without storing it again*/
+    bool idempotent = false;
+};
+
+/**
+ * @class ParserConfiguration
+ * @brief for configure libxml2 parse options
+ */
+class ParserConfiguration
+{
+public:
+    /*Getters*/
+    bool getCompact() const;
+    bool getNoNet() const;
+    bool getNoBlanks() const;
+    bool getHuge() const;
+    long long getMaxInflatedSize() const;
+
+    /*Setters*/
+    void setCompact(bool compact);
+    void setNoNet(bool noNet);
+    void setNoBlanks(bool noBlanks);
+    void setHuge(bool huge);
+    void setMaxInflatedSize(long long maxInflatedSize);
+
+    /*
+     * @brief Checks that every value is valid.
+     * @warning This method throws a runtime_error that names the invalid value.
+     */
+    void validate();
+
+private:
+    /*XML_PARSE_COMPACT : store small text nodes inside the node*/
+    bool compact = true;
+
+    /*XML_PARSE_NONET : forbid network access while parsing*/
+    bool noNet = true;
+
+    /*XML_PARSE_NOBLANKS : drop blank text nodes*/
+    bool noBlanks = false;
+
+    /*XML_PARSE_HUGE : relax the size limits of the parser*/
+    bool huge = false;
+
+    /*Largest size of an inflated document (bytes) , a larger one is rejected*/
+    long long maxInflatedSize = 256LL * 1024 * 1024;
 };
+
+/**
+ * @class PerformanceConfiguration
+ * @brief for tune SQLite , workers and batches for the hardware
+ */
+class PerformanceConfiguration
+{
+public:
+    /*Getters*/
+    const std::string &getJournalMode() const;
+    const std::string &getSynchronous() const;
+    int getCacheSize() const;
+    long long getMmapSize() const;
+    const std::string &getTempStore() const;
+    int getBusyTimeout() const;
+    int getWorkers() const;
+    int getLoaderBatchSize() const;
+    int getLoaderQueueSize() const;
+    int getPlanCacheSize() const;
+    int getStatementCacheSize() const;
+
+    /*Setters*/
+    void setJournalMode(const std::string &journalMode);
+    void setSynchronous(const std::string &synchronous);
+    void setCacheSize(int cacheSize);
+    void setMmapSize(long long mmapSize);
+    void setTempStore(const std::string &tempStore);
+    void setBusyTimeout(int busyTimeout);
+    void setWorkers(int workers);
+    void setLoaderBatchSize(int loaderBatchSize);
+    void setLoaderQueueSize(int loaderQueueSize);
+    void setPlanCacheSize(int planCacheSize);
+    void setStatementCacheSize(int statementCacheSize);
+
+    /*
+     * @brief Returns the number of worker threads (workers , or the number of
+     * hardware threads if workers is 0).
+     */
+    size_t getWorkerCount() const;
+
+    /*
+     * @brief Checks that every value is valid , pragma names are converted to upper case.
+     * @warning This method throws a runtime_error that names the invalid value.
+     */
+    void validate();
+
+private:
+    /*PRAGMA journal_mode : DELETE , TRUNCATE , PERSIST , MEMORY , WAL or OFF*/
+    std::string journalMode = "WAL";
+
+    /*PRAGMA synchronous : OFF , NORMAL , FULL or EXTRA*/
+    std::string synchronous = "NORMAL";
+
+    /*PRAGMA cache_size in KiB (page cache of the connection)*/
+    int cacheSize = 65536;
+
+    /*PRAGMA mmap_size in bytes (0 -> no memory mapped I/O)*/
+    long long mmapSize = 268435456;
+
+    /*PRAGMA temp_store : DEFAULT , FILE or MEMORY*/
+    std::string tempStore = "MEMORY";
+
+    /*Milliseconds SQLite retries a locked database before failing*/
+    int busyTimeout = 5000;
+
+    /*Parse workers of the server and the bulk loader (0 -> hardware threads)*/
+    int workers = 0;
+
+    /*Xml data stored in one transaction by the bulk loader*/
+    int loaderBatchSize = 256;
+
+    /*Max parsed xml data waiting for the writer of the bulk loader*/
+    int loaderQueueSize = 1024;
+
+    /*Insert plans of document shapes kept by the parser (0 -> no plan cache)*/
+    int planCacheSize = 1024;
+
+    /*Prepared insert statements kept by the database (0 -> prepared for each row)*/
+    int statementCacheSize = 256;
+};
+
+/**
+ * @class TraceConfiguration
+ * @brief for configure request tracing
+ */
+class TraceConfiguration
+{
+public:
+    /*Getters*/
+    int getSampleRate() const;
+    int getBufferSize() const;
+    const std::string &getPath() const;
+
+    /*Setters*/
+    void setSampleRate(int sampleRate);
+    void setBufferSize(int bufferSize);
+    void setPath(const std::string &path);
+
+    /*
+     * @brief Checks that every value is valid.
+     * @warning This method throws a runtime_error that names the invalid value.
+     */
+    void validate();
+
+private:
+    /*1 of sampleRate requests is traced (0 -> no tracing , 1 -> every request)*/
+    int sampleRate = 0;
+
+    /*Latest spans kept by each thread*/
+    int bufferSize = 8192;
+
+    /*File written on SIGUSR1 with the spans in the chrome trace format*/
+    std::string path = "trace.json";
+};
+
 /**
  * @class configuration
  *
@@ -70,13 +312,34 @@ public:
      */
     void config(int argc, char *argv[]);
 
+    /*
+     * @brief reads the configuration file again and prints every changed setting.
+     * Settings that can change at runtime are updated , the others keep their
+     * value and are reported as needing a restart.
+     * @return false if the file cannot be read or is invalid (nothing changes).
+     */
+    bool reload();
+
     /*Getters*/
     DatabaseConfiguration &getDatabaseConfig();
     ServerConfiguration &getServerConfig();
+    ParserConfiguration &getParserConfig();
+    PerformanceConfiguration &getPerformanceConfig();
+    TraceConfiguration &getTraceConfig();
+    const std::string &getImportPath() const;
 
 private:
     DatabaseConfiguration databaseConfig;
     ServerConfiguration serverConfig;
+    ParserConfiguration parserConfig;
+    PerformanceConfiguration performanceConfig;
+    TraceConfiguration traceConfig;
+
+    /*Path of the configuration file given by -f*/
+    std::string configFilePath;
+
+    /*File or directory given by -i (bulk load mode) , empty for server mode*/
+    std::string importPath;
 
     /**
      * @brief print help of program
@@ -101,6 +364,7 @@ private:
      * @warning This method throws a runtime_error if:
      * - The configuration file cannot be opened.
      * - The JSON data cannot be parsed correctly.
+     * - A value of the performance or trace section is invalid.
      *
      */
 
@@ -0,0 +1,76 @@
+/**
+ * \file : bloom.hpp
+ *
+ * set of stored uuids with false positives (Bloom filter).
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+/**
+ * BloomFilter Class
+ *
+ * A key that was added is always found , a key that was not added is found with
+ * a probability of about 1% while the filter holds at most capacity keys.
+ * Keys cannot be removed , the owner builds a larger filter when it is full.
+ *
+ * Note: not thread safe , the owner guards it.
+ */
+class BloomFilter
+{
+public:
+    BloomFilter();
+
+    /*
+     * @brief Empties the filter and sizes it for capacity keys.
+     * @param capacity
+     */
+    void reset(size_t capacity);
+
+    /*@brief Adds a key.*/
+    void add(const std::string &key);
+
+    /*
+     * @brief Checks a key.
+     * @return false if the key was never added , true if it was probably added.
+     */
+    bool mayContain(const std::string &key) const;
+
+    /*@brief Returns true if more than capacity keys were added (false positives grow).*/
+    bool isFull() const;
+
+    /*Getters*/
+    size_t getCount() const;
+    size_t getCapacity() const;
+
+private:
+    std::vector<uint64_t> bits;
+
+    size_t bitCount;
+
+    /*Number of bits set for each key*/
+    unsigned hashCount;
+
+    size_t count;
+    size_t capacity;
+
+    /*
+     * @brief Computes the two hashes , bit i of a key is (h1 + i * h2) % bitCount.
+     */
+    static void hash(const std::string &key, uint64_t &h1, uint64_t &h2);
+};
+
+} /* namespace SQLite */
+
+#endif
@@ -9,17 +9,72 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include "bloom.hpp"
 #include "config.hpp"
+#include "lock.hpp"
+#include "serializer.hpp"
 
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <sqlite3.h>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace SQLite
 {
+/*
+ * @struct TableRow
+ * @brief One row extracted from xml data : name of table ,
+ * names of properties and values of properties.
+ */
+struct TableRow
+{
+    std::string tableName;
+    std::vector<std::string> names;
+    std::vector<std::string> values;
+};
+
+/*
+ * @class ResultSink
+ * @brief receives the result of a select in chunks.
+ *
+ * write never waits for the receiver. When the receiver is full the select releases
+ * dbMutex and calls drain , so a slow client never holds the database.
+ */
+class ResultSink
+{
+public:
+    virtual ~ResultSink()
+    {
+    }
+
+    /*@brief takes a chunk , false when the receiver failed (the select is then stopped)*/
+    virtual bool write(const std::string &chunk) = 0;
+
+    /*@brief whether the receiver must catch up before more chunks are written*/
+    virtual bool isFull() const = 0;
+
+    /*@brief waits until the receiver caught up , false when it failed*/
+    virtual bool drain() = 0;
+};
+
+/*
+ * @struct DocumentRows
+ * @brief All rows of one xml data with its uuid and main table.
+ */
+struct DocumentRows
+{
+    std::string uuid;
+    std::string mainTable;
+    std::vector<TableRow> rows;
+};
+
 /**
  * DatabaseManager Class
  */
@@ -27,10 +82,13 @@ class DatabaseManager
 {
 public:
     /*
-     * @brief Construct a new DatabaseManager object.
-     * @param DatabaseConfiguration object.
+     * @brief Construct a new DatabaseManager object , opens the database and applies
+     * the pragmas of the performance configuration. In idempotent mode the uuid
+     * filter is built from the stored uuids.
+     * @param DatabaseConfiguration object , PerformanceConfiguration object.
      */
-    DatabaseManager(const DatabaseConfiguration &databaseConfiguration);
+    DatabaseManager(const DatabaseConfiguration &databaseConfiguration,
+                    const PerformanceConfiguration &performanceConfiguration);
 
     /*
      * @brief Destruct a DatabaseManager object.
@@ -75,28 +133,92 @@ public:
      */
     void insertIntoTable(const std::string &uuid, const std::vector<std::string> &names,
                          const std::vector<std::string> &values, const std::string &tableName);
+
     /*
-     * @brief Fetch data of table as xml
-     * @param name of table
-     * @return xml data
+     * @brief Inserts all rows of one xml data in a single transaction.
+     * Tables that do not exist are created before their first row.
+     *
+     * @param uuid of xml data , name of main table , rows in document order.
+     *
+     * @return false if the database is idempotent and the uuid is already stored in
+     * the main table (nothing is inserted) , true if the rows are inserted.
+     *
+     * @warning This method throws DatabaseException if a table cannot be
+     * created or a row cannot be inserted , the whole transaction is rolled back.
+     */
+    bool insertRows(const std::string &uuid, const std::string &mainTable,
+                    const std::vector<TableRow> &rows);
+
+    /*
+     * @brief Inserts a batch of xml data in a single transaction.
+     * Each xml data has its own savepoint , so one invalid xml data
+     * (for example a duplicate uuid) does not discard the rest of the batch.
+     *
+     * @param batch of xml data , vector to store the index in the batch and a message
+     * for each failed xml data , number of xml data that were already stored (idempotent
+     * database , not inserted).
+     * @return number of stored xml data.
+     *
+     * @warning This method throws DatabaseException if the transaction
+     * cannot be started or committed.
+     */
+    size_t insertDocuments(const std::vector<DocumentRows> &documents,
+                           std::vector<std::pair<size_t, std::string>> &errors,
+                           size_t &duplicates);
+    /*
+     * @brief Fetch data of table as xml , json or binary
+     * @param name of table , format , sink that receives the data in chunks
      * @warning This method throws DatabaseException if :
      * -query does not prepare
      * -table is empty
+     * -sink stops receiving data
      */
-    std::string fetchTableDataAsXML(const std::string &tableName);
+    void fetchTableData(const std::string &tableName, OutputFormat format, ResultSink &sink);
 
     /*
      * @brief Fetch all data in database
-     * @return string of xml data
+     * @param format , sink that receives the data in chunks
+     * @warning This method throws DatabaseException (see fetchTableData).
+     */
+    void fetchAllTables(OutputFormat format, ResultSink &sink);
+
+    /*
+     * @brief Fetch the rows inserted after a rowid in each table (changes since the last poll).
+     * The request is
+     * <request><operation type="changes"><table after="rowid">name</table></operation></request>
+     * (no <table> -> all tables) , format works as for a select.
+     * The result holds the tables of the request and then the table _watermarks , with
+     * one row (table , rowid) for each table : rowid is the after value of the
+     * next poll.
+     * @param tables with the rowid after which rows are returned (empty -> all tables
+     * after 0) , format , sink that receives the data in chunks
+     * @warning This method throws DatabaseException if a table does not exist (see
+     * fetchTableData).
+     */
+    void fetchChanges(const std::vector<std::pair<std::string, long long>> &watermarks,
+                      OutputFormat format, ResultSink &sink);
+
+    /*
+     * @brief Copies the write-ahead log into the database file and truncates it.
+     * Does nothing if the database is not in WAL mode.
+     * @warning This method throws DatabaseException if the checkpoint fails.
+     */
+    void checkpoint();
+
+    /*
+     * @brief applies the settings that can change while the database is open
+     * (synchronous , cache_size , mmap_size , temp_store , busy_timeout pragmas and
+     * the size of the statement cache).
+     * @warning This method throws DatabaseException if a pragma cannot be applied.
      */
-    std::string fetchAllTablesAsXML();
+    void tune(const PerformanceConfiguration &performanceConfiguration);
 
     /*Getters*/
     sqlite3 *getDatabase() const;
 
 private:
     /*Mutex*/
-    std::mutex dbMutex;
+    InstrumentedMutex dbMutex {"dbMutex"};
 
     /* Name of database file*/
     std::string fileName;
@@ -104,6 +226,21 @@ private:
     /* Object from database */
     sqlite3 *database;
 
+    /*Prepared insert statements by query , reused while the schema does not change*/
+    std::unordered_map<std::string, sqlite3_stmt *> statements;
+
+    /*Max cached statements (0 -> statements are finalized after use)*/
+    size_t statementCacheSize;
+
+    /*Whether stored uuids are checked before insert*/
+    bool idempotent;
+
+    /*(main table , uuid) of stored xml data , confirmed by the primary key index*/
+    BloomFilter uuidFilter;
+
+    /*Whether a table has the uuid primary key , only for existing tables*/
+    std::unordered_map<std::string, bool> uuidKeyTables;
+
     /*
      * @brief open database.
      * @warning This method throws DatabaseException if database doesnt
@@ -116,6 +253,93 @@ private:
      */
     void closeDatabase();
 
+    /*
+     * @brief applies journal_mode , synchronous , cache_size , mmap_size , temp_store
+     * and busy_timeout.
+     * @warning This method throws DatabaseException if a pragma cannot be applied.
+     */
+    void applyPragmas(const PerformanceConfiguration &performanceConfiguration);
+
+    /*
+     * @brief returns the prepared statement of query from the cache , prepares and
+     * caches it if needed. The caller must hold dbMutex and pass the statement to
+     * releaseStatementLocked after use.
+     * @warning This method throws DatabaseException if the query cannot be prepared.
+     */
+    sqlite3_stmt *prepareCachedLocked(const std::string &query);
+
+    /*
+     * @brief resets a statement of prepareCachedLocked for the next use.
+     */
+    void releaseStatementLocked(sqlite3_stmt *stmt);
+
+    /*
+     * @brief finalizes all cached statements , the caller must hold dbMutex.
+     * Called after a rollback (a cached statement may use a table that was rolled back).
+     */
+    void clearStatementsLocked();
+
+    /*
+     * @brief Builds the uuid filter from the uuids of all tables with a uuid
+     * primary key , the caller must hold dbMutex.
+     * @param minimum capacity of the filter.
+     */
+    void buildUuidFilterLocked(size_t minimum);
+
+    /*
+     * @brief Checks whether table exists and has the uuid primary key (main table).
+     */
+    bool isUuidKeyTableLocked(const std::string &table);
+
+    /*
+     * @brief Checks whether uuid is stored in mainTable , the filter answers most
+     * checks , a possible match is confirmed with the primary key index.
+     * @return false if the database is not idempotent.
+     */
+    bool isStoredLocked(const std::string &mainTable, const std::string &uuid);
+
+    /*
+     * @brief Adds a stored uuid to the filter , a full filter is built again with
+     * twice its capacity.
+     */
+    void rememberUuidLocked(const std::string &mainTable, const std::string &uuid);
+
+    /*
+     * @brief Locks dbMutex , the wait is recorded as the db.wait span of a traced
+     * request.
+     */
+    std::unique_lock<InstrumentedMutex> lockDatabase();
+
+    /*
+     * @brief Same as tune but the caller must hold dbMutex.
+     */
+    void tuneLocked(const PerformanceConfiguration &performanceConfiguration);
+
+    /*
+     * @brief Executes a query that returns no rows (BEGIN , COMMIT , ...).
+     * @param query , message of exception
+     * @warning This method throws DatabaseException if query cannot be execute.
+     */
+    void execute(const std::string &query, const std::string &errorMessage);
+
+    /*
+     * Same as the public methods but the caller must hold dbMutex.
+     */
+    bool isExistTableLocked(const std::string &name);
+    void createTableLocked(const std::string &name, const std::vector<std::string> &properties,
+                           bool isMainTable, const std::string &mainTable);
+    void insertIntoTableLocked(const std::string &uuid, const std::vector<std::string> &names,
+                               const std::vector<std::string> &values,
+                               const std::string &tableName);
+
+    /*
+     * @brief Inserts the rows of one xml data , the caller must hold dbMutex.
+     * @param uuid , name of main table , rows , tables already checked (updated).
+     */
+    void insertRowsLocked(const std::string &uuid, const std::string &mainTable,
+                          const std::vector<TableRow> &rows,
+                          std::unordered_set<std::string> &knownTables);
+
     /*
      * @brief Create query for isExistTable method.
      * @param  name of table
@@ -153,12 +377,49 @@ private:
     std::string queryAllTableNames();
 
     /*
-     * @brief Create query for SELECT table.
+     * @brief Create query for the rows of a table after a rowid (bound as parameter 1) ,
+     * the rowid is the first column.
      * @param name of table.
      * @return query
      */
+    std::string querySelectAfter(const std::string &tableName);
+
+    /*
+     * @brief Writes a table with serializer and passes it to sink , the caller holds
+     * dbMutex with lock. The lock is released while a full sink drains.
+     * @param lock , name of table , serializer , whether it is the first table of the
+     * result , sink , rowid after which rows are written (minimum -> all rows)
+     * @return the rowid of the last row written (after if there is none)
+     * @warning This method throws DatabaseException (see fetchTableData).
+     */
+    long long fetchTableLocked(std::unique_lock<InstrumentedMutex> &lock,
+                               const std::string &tableName, ResultSerializer &serializer,
+                               bool first, ResultSink &sink,
+                               long long after = std::numeric_limits<long long>::min());
+
+    /*
+     * @brief Returns a new serializer of format for one select.
+     */
+    static std::unique_ptr<ResultSerializer> makeSerializer(OutputFormat format);
+
+    /*
+     * @brief Passes the data of serializer to sink and clears it.
+     * @param serializer , sink
+     * @warning This method throws DatabaseException if sink stops receiving data.
+     */
+    void flushToSink(ResultSerializer &serializer, ResultSink &sink);
+
+    /*
+     * @brief Passes data to sink.
+     * @warning This method throws DatabaseException if sink stops receiving data.
+     */
+    void sendToSink(const std::string &data, ResultSink &sink);
 
-    std::string querySelect(const std::string &tableName);
+    /*
+     * @brief Waits without dbMutex until a full sink caught up.
+     * @warning This method throws DatabaseException if sink stops receiving data.
+     */
+    void drainSink(ResultSink &sink);
 };
 /**
  * DatabaseException Class
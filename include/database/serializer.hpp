@@ -0,0 +1,213 @@
+/**
+ * \file : serializer.hpp
+ *
+ * output formats of select results (xml , json , binary).
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+/*
+ * Format of a select result , selected by the format attribute of <operation> :
+ * "xml" (default) , "json" or "binary".
+ */
+enum class OutputFormat
+{
+    xml,
+    json,
+    binary
+};
+
+/**
+ * ResultSerializer Class
+ *
+ * Writes the tables of a select result to a growable buffer that is reused for
+ * every chunk , clear() keeps its capacity , so a long select does not allocate
+ * once the buffer is large enough.
+ *
+ * A result is : header , tables (beginTable , rows , endTable) , footer.
+ * The header and footer are returned as strings , they are passed to the sink
+ * directly while the tables of a whole database are written one by one.
+ */
+class ResultSerializer
+{
+public:
+    /*
+     * @brief Construct a new ResultSerializer object.
+     * @param initial capacity of the buffer.
+     */
+    ResultSerializer(size_t capacity);
+
+    virtual ~ResultSerializer();
+
+    /*
+     * @brief Returns what comes before the first table.
+     * @param true for a result with all tables of the database.
+     */
+    virtual std::string header(bool allTables) const = 0;
+
+    /*
+     * @brief Returns what comes after the last table.
+     * @param true for a result with all tables of the database.
+     */
+    virtual std::string footer(bool allTables) const = 0;
+
+    /*
+     * @brief Starts a table.
+     * @param name of table , names of columns , whether it is the first table of the result.
+     */
+    virtual void beginTable(const std::string &name, const std::vector<std::string> &columns,
+                            bool first) = 0;
+
+    /*
+     * @brief Appends one value of the current row.
+     * @param index of column , value (nullptr -> NULL) , size of value.
+     */
+    virtual void appendValue(size_t column, const char *value, size_t size) = 0;
+
+    /*@brief Starts and ends a row.*/
+    virtual void beginRow() = 0;
+    virtual void endRow() = 0;
+
+    /*@brief Ends the current table.*/
+    virtual void endTable() = 0;
+
+    /*
+     * @brief Empties the buffer , its capacity is kept.
+     */
+    void clear();
+
+    /*Getters*/
+    const std::string &getBuffer() const;
+    size_t size() const;
+
+protected:
+    std::string buffer;
+
+    /*Name and columns of the current table*/
+    std::string tableName;
+    std::vector<std::string> columns;
+};
+
+/**
+ * XmlSerializer Class
+ *
+ * <table>
+ *     <column>value</column>
+ * </table>
+ *
+ * Text is escaped only where needed : values are scanned 16 bytes at a time and
+ * values without special characters are copied at once.
+ */
+class XmlSerializer : public ResultSerializer
+{
+public:
+    XmlSerializer(size_t capacity);
+
+    std::string header(bool allTables) const override;
+    std::string footer(bool allTables) const override;
+    void beginTable(const std::string &name, const std::vector<std::string> &columns,
+                    bool first) override;
+    void appendValue(size_t column, const char *value, size_t size) override;
+    void beginRow() override;
+    void endRow() override;
+    void endTable() override;
+
+private:
+    /*
+     * @brief appends text , '<' , '>' and '&' are replaced by entities.
+     */
+    void appendText(const char *text, size_t size);
+
+    /*
+     * @brief Returns the index of the first character of text that must be
+     * escaped , or size if there is none.
+     */
+    static size_t findSpecial(const char *text, size_t size);
+};
+
+/**
+ * JsonSerializer Class
+ *
+ * {"table":"name","columns":["a","b"],"rows":[
+ * ["1","2"],
+ * ["3",null]
+ * ]}
+ *
+ * Names of columns are written once per table , rows are arrays of values.
+ */
+class JsonSerializer : public ResultSerializer
+{
+public:
+    JsonSerializer(size_t capacity);
+
+    std::string header(bool allTables) const override;
+    std::string footer(bool allTables) const override;
+    void beginTable(const std::string &name, const std::vector<std::string> &columns,
+                    bool first) override;
+    void appendValue(size_t column, const char *value, size_t size) override;
+    void beginRow() override;
+    void endRow() override;
+    void endTable() override;
+
+private:
+    /*Rows of the current table*/
+    size_t rows;
+
+    /*
+     * @brief appends a json string , '"' , '\' and control characters are escaped.
+     */
+    void appendString(const char *text, size_t size);
+
+    /*
+     * @brief Returns the index of the first character of text that must be
+     * escaped , or size if there is none.
+     */
+    static size_t findSpecial(const char *text, size_t size);
+};
+
+/**
+ * BinarySerializer Class
+ *
+ * Length-prefixed rows , integers are little endian :
+ * result : "DBMB" , version (1 byte) , tables , 'Z'.
+ * table  : 'T' , name , number of columns (u32) , names of columns , rows , 'E'.
+ * row    : 'R' , one value for each column.
+ * name / value : size (u32) , bytes. A NULL value has size 0xFFFFFFFF and no bytes.
+ */
+class BinarySerializer : public ResultSerializer
+{
+public:
+    BinarySerializer(size_t capacity);
+
+    std::string header(bool allTables) const override;
+    std::string footer(bool allTables) const override;
+    void beginTable(const std::string &name, const std::vector<std::string> &columns,
+                    bool first) override;
+    void appendValue(size_t column, const char *value, size_t size) override;
+    void beginRow() override;
+    void endRow() override;
+    void endTable() override;
+
+private:
+    /*@brief appends value as 4 little endian bytes*/
+    void appendUint32(uint32_t value);
+
+    /*@brief appends size and bytes*/
+    void appendBytes(const char *data, size_t size);
+};
+
+} /* namespace SQLite */
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ *
+ * \file : loader.hpp
+ *
+ * offline bulk load of xml files into the database.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "config.hpp"
+#include "database.hpp"
+#include "parser.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * @class MappedFile
+ * @brief a read-only memory mapping of a whole file.
+ */
+class MappedFile
+{
+public:
+    /*
+     * @brief Construct a new MappedFile object and maps the file.
+     * @param path of file
+     * @warning throws LoaderException if the file cannot be opened or mapped.
+     */
+    MappedFile(const std::string &path);
+
+    /*
+     * @brief Destruct a MappedFile object , unmaps the file.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /*Getters*/
+    const char *getData() const;
+    size_t getSize() const;
+
+private:
+    const char *data;
+    size_t size;
+};
+
+/*
+ * @class BulkLoader
+ * @brief loads xml files straight into the database without the socket.
+ *
+ * Files are memory mapped and parsed by several parse workers , every worker
+ * owns a parser context. The rows of parsed files are passed through a bounded
+ * queue to a single writer that stores them in batches , one transaction per batch.
+ */
+class BulkLoader
+{
+public:
+    /*
+     * @brief Construct a new BulkLoader object.
+     * @param object of Configuration , path of a xml file or a directory of xml files.
+     */
+    BulkLoader(Configuration &configuration, const std::string &path);
+
+    /*
+     * @brief Loads all files and prints progress and throughput.
+     * @warning throws LoaderException if path cannot be read.
+     */
+    void run();
+
+private:
+    Configuration &configuration;
+
+    /*File or directory given by -i*/
+    std::string path;
+
+    /*Number of xml data stored in one transaction*/
+    size_t batchSize;
+
+    /*Maximum number of parsed xml data waiting for the writer*/
+    size_t queueCapacity;
+
+    /*Files to load*/
+    std::vector<std::string> files;
+
+    /*Index of the next file for parse workers*/
+    std::atomic<size_t> nextFile;
+
+    /*Parsed xml data waiting for the writer , with the path of its file*/
+    std::deque<std::pair<std::string, SQLite::DocumentRows>> documents;
+    std::mutex queueMtx;
+    std::condition_variable queueNotFull;
+    std::condition_variable queueNotEmpty;
+
+    /*Number of parse workers that are still running*/
+    size_t runningWorkers;
+
+    /*Counters for progress*/
+    std::atomic<size_t> parsedFiles;
+    std::atomic<size_t> parsedBytes;
+    std::atomic<size_t> storedFiles;
+    std::atomic<size_t> failedFiles;
+
+    /*Files whose uuid was already stored (idempotent database)*/
+    std::atomic<size_t> duplicateFiles;
+
+    std::mutex coutMtx;
+
+    std::chrono::steady_clock::time_point startTime;
+
+    /*
+     * @brief collects the files to load , a directory is searched recursively
+     * for files with .xml extension.
+     * @param path of file or directory
+     */
+    void collectFiles(const std::string &path);
+
+    /*
+     * @brief parse worker : maps , parses and extracts rows of files.
+     * @param parser shared by workers
+     */
+    void parseFiles(XML::Parser *parser);
+
+    /*
+     * @brief writer : stores parsed xml data in batches.
+     * @param pointer to instance of DatabaseManager
+     */
+    void writeDocuments(SQLite::DatabaseManager *database);
+
+    /*
+     * @brief pushes parsed xml data to the queue , waits while the queue is full.
+     * @param path of the file , xml data
+     */
+    void pushDocument(const std::string &path, SQLite::DocumentRows &&document);
+
+    /*
+     * @brief prints number of files , and throughput since start.
+     * @param final -> whether it is the last report
+     */
+    void printProgress(bool final);
+
+    /*
+     * @brief prints an error for one file.
+     */
+    void printError(const std::string &file, const std::string &message);
+};
+
+/*
+ * To handle bulk load exceptions
+ */
+class LoaderException : public std::runtime_error
+{
+public:
+    LoaderException(const std::string &message) : std::runtime_error(message)
+    {
+    }
+};
+#endif
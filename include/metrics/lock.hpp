@@ -0,0 +1,150 @@
+/**
+ *
+ * \file : lock.hpp
+ *
+ * mutexes that record how long threads wait for them and hold them.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+/*
+ * @class LockHistogram
+ * @brief counts durations in power of two buckets of nanoseconds.
+ *
+ * Bucket 0 counts 0 ns , bucket i counts durations below 2^i ns and at least
+ * 2^(i-1) ns , the last bucket counts everything longer (about 1 second).
+ */
+class LockHistogram
+{
+public:
+    static const int bucketCount = 32;
+
+    LockHistogram();
+
+    /*@brief adds a duration , may be called from any thread*/
+    void add(long long nanoseconds);
+
+    /*
+     * @brief writes the non empty buckets as <tag below="ns">count</tag> elements ,
+     * below="inf" for the last bucket.
+     */
+    void toXML(std::ostream &xmlStream, const char *tag) const;
+
+    /*Getters*/
+    long long getTotal() const;
+    long long getMax() const;
+
+private:
+    std::atomic<long long> buckets[bucketCount];
+
+    /*Sum and longest of all durations in nanoseconds*/
+    std::atomic<long long> total;
+    std::atomic<long long> max;
+};
+
+/*
+ * @class LockStats
+ * @brief acquisitions , contention , wait and hold times of every mutex with one name.
+ * Mutexes with the same name (clientMtx of every client) share their stats.
+ */
+class LockStats
+{
+public:
+    LockStats();
+
+    /*
+     * @brief adds one acquisition.
+     * @param whether the mutex was locked by another thread , nanoseconds waited.
+     */
+    void acquired(bool contended, long long waitNanoseconds);
+
+    /*@brief adds the time the mutex was held by one acquisition*/
+    void released(long long holdNanoseconds);
+
+    /*@brief writes the stats as a <lock> element*/
+    void toXML(std::ostream &xmlStream, const std::string &name) const;
+
+private:
+    std::atomic<long long> acquisitions;
+
+    /*Acquisitions that found the mutex locked and had to wait*/
+    std::atomic<long long> contentions;
+
+    LockHistogram wait;
+    LockHistogram hold;
+};
+
+#ifdef DBM_LOCK_STATS
+
+/*
+ * @class InstrumentedMutex
+ * @brief a mutex that records its wait and hold times in the LockStats of its name.
+ *
+ * A free mutex is taken with try_lock , so an uncontended acquisition reads the
+ * clock once , a contended one reads it twice to measure the wait.
+ * Condition variables of an instrumented mutex are condition_variable_any.
+ */
+class InstrumentedMutex
+{
+public:
+    /*
+     * @brief Construct a new InstrumentedMutex object.
+     * @param name of the lock in the stats (a mutex member name like "dbMutex").
+     */
+    explicit InstrumentedMutex(const char *name);
+
+    InstrumentedMutex(const InstrumentedMutex &) = delete;
+    InstrumentedMutex &operator=(const InstrumentedMutex &) = delete;
+
+    void lock();
+    void unlock();
+    bool try_lock();
+
+private:
+    std::mutex mutex;
+
+    LockStats &stats;
+
+    /*When the owner took the mutex (only used by the owner)*/
+    std::chrono::steady_clock::time_point acquiredAt;
+};
+
+using InstrumentedCondition = std::condition_variable_any;
+
+/*Lock to wait on an InstrumentedCondition*/
+using InstrumentedLock = std::unique_lock<InstrumentedMutex>;
+
+#else
+
+/*
+ * @class InstrumentedMutex
+ * @brief a plain std::mutex when lock stats are not compiled in (DBM_LOCK_STATS) ,
+ * the name is ignored and nothing is recorded.
+ */
+class InstrumentedMutex : public std::mutex
+{
+public:
+    explicit InstrumentedMutex(const char *)
+    {
+    }
+};
+
+using InstrumentedCondition = std::condition_variable;
+
+/*Lock to wait on an InstrumentedCondition*/
+using InstrumentedLock = std::unique_lock<std::mutex>;
+
+#endif
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ *
+ * \file : metrics.hpp
+ *
+ * counters and lock stats of the server , reported by the stats operation.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "lock.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*
+ * @class Counter
+ * @brief a named number that can be changed from any thread without locking.
+ */
+class Counter
+{
+public:
+    Counter();
+
+    /*@brief adds value (may be negative for gauges like connected clients)*/
+    void add(long long value = 1);
+
+    /*Getters*/
+    long long get() const;
+
+private:
+    std::atomic<long long> value;
+};
+
+/*
+ * @class Metrics
+ * @brief registry of all counters of the program.
+ *
+ * Counters and histograms are created on first use and never removed , so a reference
+ * returned by counter() stays valid and can be kept by the caller to avoid the lookup.
+ */
+class Metrics
+{
+public:
+    /*@brief returns the registry of the program*/
+    static Metrics &instance();
+
+    /*
+     * @brief returns the counter with this name , creates it if it doesn't exist.
+     * @param name of counter
+     */
+    Counter &counter(const std::string &name);
+
+    /*
+     * @brief returns the stats of the locks with this name , creates them if they
+     * don't exist (only used when DBM_LOCK_STATS is defined).
+     * @param name of lock
+     */
+    LockStats &lockStats(const std::string &name);
+
+    /*
+     * @brief returns the histogram of durations with this name , creates it if it
+     * doesn't exist.
+     * @param name of histogram
+     */
+    LockHistogram &histogram(const std::string &name);
+
+    /*
+     * @brief returns all metrics as xml , with the uptime in milliseconds so
+     * rates (for example accepts per second of an acceptor) can be computed.
+     * Histograms and lock stats follow the counters.
+     */
+    std::string toXML();
+
+private:
+    Metrics();
+
+    std::chrono::steady_clock::time_point startTime;
+
+    std::mutex metricsMtx;
+
+    /*Sorted by name for a stable output*/
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<LockHistogram>> histograms;
+    std::map<std::string, std::unique_ptr<LockStats>> locks;
+};
+#endif
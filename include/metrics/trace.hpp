@@ -0,0 +1,203 @@
+/**
+ *
+ * \file : trace.hpp
+ *
+ * spans of sampled requests , exported in the chrome trace format.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * @struct TraceEvent
+ * @brief a finished span : a named interval of one request on one thread.
+ * Times are microseconds since the tracer started.
+ */
+struct TraceEvent
+{
+    uint64_t traceId;
+
+    /*Name of the span , a string literal*/
+    const char *name;
+
+    long long start;
+    long long duration;
+
+    /*Kernel id of the thread that recorded the span*/
+    int thread;
+};
+
+/*
+ * @class TraceBuffer
+ * @brief ring of the latest spans recorded by one thread.
+ *
+ * Only the owning thread writes , without locking. Every slot has a sequence
+ * number that is odd while the slot is written , so a reader skips slots that
+ * change while they are copied.
+ */
+class TraceBuffer
+{
+public:
+    /*
+     * @brief Construct a new TraceBuffer object.
+     * @param max number of spans , older spans are overwritten.
+     */
+    TraceBuffer(size_t capacity);
+
+    /*@brief adds a span , only called by the thread that owns the buffer*/
+    void record(const TraceEvent &event);
+
+    /*@brief appends the spans of the buffer to events , may be called by any thread*/
+    void collect(std::vector<TraceEvent> &events) const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;
+        TraceEvent event;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+
+    size_t capacity;
+
+    /*Number of spans recorded so far*/
+    std::atomic<uint64_t> head;
+};
+
+/*
+ * @class Tracer
+ * @brief records the spans of sampled requests into the buffers of the threads.
+ *
+ * A request gets a trace id when it is sampled (1 of sampleRate requests) , the id
+ * is made current on every thread that works on the request , and spans recorded
+ * while it is current belong to that request.
+ * A thread that is not working on a sampled request records nothing and does not
+ * read the clock.
+ *
+ * Buffers are created on the first span of a thread and given to a new thread when
+ * their thread exits , so short lived client threads do not add buffers.
+ */
+class Tracer
+{
+public:
+    /*@brief returns the tracer of the program*/
+    static Tracer &instance();
+
+    /*
+     * @brief Returns the trace id of a new request , 0 if the request is not sampled.
+     */
+    uint64_t startRequest();
+
+    /*
+     * @brief Adds a span to the buffer of the calling thread.
+     * @param trace id (0 -> nothing is recorded) , name (string literal) , start and end.
+     */
+    void record(uint64_t traceId, const char *name, std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end);
+
+    /*
+     * @brief returns the recorded spans as chrome trace json (chrome://tracing or
+     * https://ui.perfetto.dev) , every span has its trace id as argument.
+     */
+    std::string toChromeJSON();
+
+    /*
+     * @brief writes toChromeJSON to a file.
+     * @return number of spans written.
+     * @warning This method throws a runtime_error if the file cannot be written.
+     */
+    size_t writeChromeJSON(const std::string &path);
+
+    /*
+     * @brief Sets the trace id of the calling thread , 0 -> no request.
+     */
+    static void setCurrent(uint64_t traceId);
+
+    /*Getters*/
+    static uint64_t getCurrent();
+    int getSampleRate() const;
+    size_t getBufferSize() const;
+
+    /*Setters*/
+    void setSampleRate(int sampleRate);
+    void setBufferSize(size_t bufferSize);
+
+private:
+    Tracer();
+
+    /*
+     * @brief returns the buffer of the calling thread , takes a free buffer or
+     * creates one on the first call.
+     */
+    TraceBuffer *threadBuffer();
+
+    /*@brief gives the buffer of an exiting thread to the next new thread*/
+    void releaseBuffer(TraceBuffer *buffer);
+
+    /*@brief returns the spans of all buffers sorted by start time*/
+    std::vector<TraceEvent> collectEvents();
+
+    /*@brief formats spans as chrome trace json*/
+    static std::string chromeJSON(const std::vector<TraceEvent> &events);
+
+    friend struct TraceBufferOwner;
+
+    std::chrono::steady_clock::time_point startTime;
+
+    /*1 of sampleRate requests is traced (0 -> tracing disabled)*/
+    std::atomic<int> sampleRate;
+
+    /*Spans of a new buffer*/
+    std::atomic<size_t> bufferSize;
+
+    /*Requests seen , and the last trace id given*/
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> lastTraceId;
+
+    std::mutex buffersMtx;
+
+    /*All buffers (never removed) , and those whose thread has exited*/
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::vector<TraceBuffer *> freeBuffers;
+};
+
+/*
+ * @class TraceSpan
+ * @brief records a span of the current request of the thread from its construction
+ * to its destruction (or to end()).
+ */
+class TraceSpan
+{
+public:
+    /*
+     * @brief Construct a new TraceSpan object.
+     * @param name of span (string literal).
+     */
+    TraceSpan(const char *name);
+
+    ~TraceSpan();
+
+    /*@brief records the span now , the destructor records nothing after this*/
+    void end();
+
+private:
+    const char *name;
+
+    /*Trace id when the span started (0 -> not recorded)*/
+    uint64_t traceId;
+
+    std::chrono::steady_clock::time_point start;
+};
+#endif
@@ -0,0 +1,28 @@
+/**
+ *
+ * \file : compression.hpp
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+namespace XML
+{
+
+/*
+ * Compression of the xml data sent by a client.
+ * Selected by the character after the 15 digits of data length :
+ * 'g' -> gzip , 'd' -> deflate (zlib format) , anything else -> none.
+ */
+enum class Compression
+{
+    none,
+    deflate,
+    gzip
+};
+
+} /*namespace XML*/
+#endif
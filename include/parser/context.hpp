@@ -0,0 +1,95 @@
+/**
+ *
+ * \file : context.hpp
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "compression.hpp"
+#include "config.hpp"
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <string>
+
+namespace XML
+{
+
+/*
+ * Class ParserContext
+ *
+ * A long-lived libxml2 parser context owned by one worker thread.
+ * The context is reset between documents instead of being allocated
+ * for each of them , so its name dictionary stays warm and element
+ * names of repeated documents are not allocated again.
+ *
+ * Note: a context must not be used by two threads at the same time.
+ */
+class ParserContext
+{
+public:
+    /*
+     * @brief Construct a new ParserContext object.
+     * @param object of ParserConfiguration (parse options)
+     * @warning throws ParseXmlException if the context cannot be created.
+     */
+    ParserContext(const ParserConfiguration &parserConfig);
+
+    /*
+     * @brief Destruct a ParserContext object.
+     */
+    ~ParserContext();
+
+    ParserContext(const ParserContext &) = delete;
+    ParserContext &operator=(const ParserContext &) = delete;
+
+    /*
+     * @brief Parses a document from memory with the reused context.
+     * @param data , size of data
+     * @return parsed document , the caller frees it with xmlFreeDoc.
+     * @warning throws ParseXmlException if the document cannot be parsed.
+     */
+    xmlDocPtr readMemory(const char *data, size_t size);
+
+    /*
+     * @brief Parses a compressed document from memory with the reused context.
+     * The data is inflated chunk by chunk and each chunk is pushed to the
+     * parser , so the whole inflated document is never stored.
+     * @param compressed data , size of data , compression (deflate or gzip) ,
+     * inflatedSize -> set to the size of the inflated document.
+     * @return parsed document , the caller frees it with xmlFreeDoc.
+     * @warning throws ParseXmlException if the data cannot be inflated or parsed , or
+     * inflates to more than maxInflatedSize bytes.
+     */
+    xmlDocPtr readCompressed(const char *data, size_t size, Compression compression,
+                             size_t &inflatedSize);
+
+    /*
+     * @brief Parses a document with readMemory or readCompressed.
+     * @param data , size of data , compression ,
+     * documentSize -> set to the size of the (inflated) document.
+     * @return parsed document , the caller frees it with xmlFreeDoc.
+     * @warning throws ParseXmlException if the document cannot be parsed.
+     */
+    xmlDocPtr read(const char *data, size_t size, Compression compression,
+                   size_t &documentSize);
+
+    /*Getters*/
+    int getOptions() const;
+
+private:
+    xmlParserCtxtPtr context;
+
+    /*libxml2 XML_PARSE_* flags*/
+    int options;
+
+    /*Largest size of an inflated document (bytes)*/
+    unsigned long maxInflatedSize;
+};
+
+} /*namespace XML*/
+#endif
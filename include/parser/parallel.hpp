@@ -0,0 +1,121 @@
+/**
+ *
+ * \file : parallel.hpp
+ *
+ * helpers to split the work of one large document between threads.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace XML
+{
+
+/*Documents smaller than this (in bytes) are built by one thread.*/
+const size_t parallelBuildThreshold = 1 << 20;
+
+/*Trees with fewer nodes than this are stored by one thread.*/
+const size_t parallelStoreThreshold = 4096;
+
+/*
+ * @brief Returns the helper threads running for all documents.
+ * Documents parsed by several request workers at once share the cores , so the
+ * helpers of all of them together are bounded by the number of cores.
+ */
+inline std::atomic<size_t> &runningHelpers()
+{
+    static std::atomic<size_t> running {0};
+    return running;
+}
+
+/*
+ * @brief Reserves up to wanted helper threads , fewer (or none) when the helpers of
+ * other documents already use the cores.
+ * @return the number of helpers reserved , released with releaseHelpers.
+ */
+inline size_t reserveHelpers(size_t wanted)
+{
+    size_t cores = std::thread::hardware_concurrency();
+    size_t limit = cores > 1 ? cores - 1 : 0;
+
+    std::atomic<size_t> &running = runningHelpers();
+    size_t current = running.load();
+
+    while (true) {
+        size_t granted = current >= limit ? 0 : std::min(wanted, limit - current);
+        if (granted == 0 || running.compare_exchange_weak(current, current + granted))
+            return granted;
+    }
+}
+
+inline void releaseHelpers(size_t count)
+{
+    runningHelpers() -= count;
+}
+
+/*
+ * @brief Calls function(index) for every index in [0 , count) on several threads.
+ *
+ * Tasks are handed out one by one from a shared counter, so a few big subtrees
+ * don't leave the other threads idle. The caller keeps the result of each task
+ * in its own slot and merges them in index order to keep the document order.
+ * The calling thread works too , helper threads are only started while the
+ * helpers of all documents are below the number of cores.
+ * When a task throws (bad_alloc of a huge document) no more tasks are started and
+ * the first exception is rethrown on the calling thread after all threads ended.
+ *
+ * @param count -> number of tasks , function -> task
+ */
+template <typename Function>
+void parallelFor(size_t count, Function function)
+{
+    std::atomic<size_t> nextIndex {0};
+
+    size_t helpers = count > 1 ? reserveHelpers(count - 1) : 0;
+    std::vector<std::exception_ptr> errors(helpers + 1);
+
+    auto worker = [&nextIndex, &errors, count, &function](size_t slot) {
+        try {
+            for (size_t i = nextIndex++; i < count; i = nextIndex++)
+                function(i);
+        } catch (...) {
+            errors[slot] = std::current_exception();
+            nextIndex = count;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(helpers);
+    try {
+        for (size_t i = 1; i <= helpers; i++)
+            workers.emplace_back(worker, i);
+    } catch (const std::system_error &) {
+        /*A thread that can't be started leaves its tasks to the others*/
+    }
+
+    /*The calling thread works too*/
+    worker(0);
+
+    for (std::thread &thread : workers)
+        thread.join();
+
+    releaseHelpers(helpers);
+
+    for (std::exception_ptr &error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+} /*namespace XML*/
+#endif
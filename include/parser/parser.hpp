@@ -5,8 +5,13 @@
  *
  */
 
+#ifndef PARSER_H
+#define PARSER_H
+
 #include "client.hpp"
+#include "context.hpp"
 #include "database.hpp"
+#include "plan.hpp"
 #include "tree.hpp"
 
 using namespace SQLite;
@@ -21,27 +26,77 @@ namespace XML
 class Parser
 {
 public:
+    /*
+     * @brief Construct a new Parser object.
+     * @param max number of cached insert plans (0 -> every document builds a tree).
+     */
+    Parser(size_t planCacheSize);
+
     /*
      *
      * @brief Process xmlData and store it in database
      *
-     * @param pointer to instance of client , pointer to instance of DatabaseManager class
+     * @param pointer to instance of client , pointer to instance of DatabaseManager class ,
+     * parser context owned by the calling worker.
      *
      *	Note: handles exceptions related to XML parsing and database intractions.
      */
-    void parseAndStoreXmlData(Client *client, DatabaseManager *database);
+    void parseAndStoreXmlData(Client *client, DatabaseManager *database, ParserContext *context);
+
+    /*
+     * @brief Collects the rows (tables , names and values of properties) of all nodes of tree.
+     * @param pointer to instance of Tree , vector to store rows in document order.
+     */
+    void collectDocumentRows(Tree *tree, std::vector<TableRow> &rows);
+
+    /*
+     * @brief Collects the uuid , main table and rows of a parsed document.
+     * If an insert plan of the shape of the document is cached , the rows are read
+     * with the plan and no tree is built , otherwise a tree is built and the plan
+     * of an insert document is cached.
+     *
+     * @param parsed document (always freed , by this method or by the returned tree) ,
+     * size of document , document to fill (only for insert documents).
+     *
+     * @return nullptr if the plan was used , otherwise the tree of the document
+     * (the caller deletes it).
+     *
+     * @warning throws ParseXmlException if the document is not valid.
+     */
+    Tree *collectDocument(xmlDocPtr xmlDoc, size_t documentSize, DocumentRows &document);
+
+    /*Setters*/
+    void setPlanCacheSize(size_t planCacheSize);
 
 private:
+    /*Insert plans of repeated document shapes*/
+    PlanCache plans;
+
+    /*
+     * @brief Creates the insert plan of the tree , rows are in the order of
+     * collectDocumentRows.
+     * @param shape of the document of the tree , tree of an insert document.
+     * @return plan
+     */
+    std::shared_ptr<InsertPlan> buildPlan(const DocumentShape &shape, Tree *tree);
+
+    /*
+     * @brief Returns the output format of a select.
+     * @param format attribute of <operation> (empty -> xml).
+     */
+    static OutputFormat outputFormat(const std::string &format);
+
+    /*
+     * @brief Non-Recursively collects rows of the subtree below root.
+     * @param pointer to root of subtree , vector to store rows in document order.
+     */
+    void collectTableRows(Node *root, std::vector<TableRow> &rows);
+
     /*
-     * @brief Process all nodes recursive and store in database
-     * @param pointer to instance of Tree,
-     * -pointer to root of tree,
-     * -uuid
-     * -name of main table
-     * -pointer to instance of DatabaseManager
+     * @brief Adds the row of node if the node is a table.
+     * @param pointer to node , vector to store rows.
      */
-    void storeXmlNodesInDatabase(Tree *tree, Node *root, const std::string &uuid,
-                                 const std::string &mainTable, DatabaseManager *database);
+    void collectNodeRow(Node *node, std::vector<TableRow> &rows);
 
     /*
      * @brief handle exception
@@ -53,3 +108,4 @@ private:
 };
 
 } /* namespace XML */
+#endif
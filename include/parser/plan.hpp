@@ -0,0 +1,137 @@
+/**
+ *
+ * \file : plan.hpp
+ *
+ * insert plans of repeated document shapes.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "database.hpp"
+
+#include <cstdint>
+#include <libxml/tree.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace XML
+{
+
+/*Documents with more elements than this are not planned (they use the tree).*/
+const size_t planMaxElements = 4096;
+
+/*
+ * Struct DocumentShape
+ *
+ * The element structure of a parsed document without its text :
+ * names of elements in document order and how they are nested.
+ * Two documents with the same skeleton have the same tables , properties and uuid.
+ */
+struct DocumentShape
+{
+    /*
+     * @brief Walks the elements of doc in document order and builds the skeleton.
+     * @param parsed document (not owned).
+     */
+    DocumentShape(xmlDocPtr doc);
+
+    /*Element nodes in document order (the root is the first one)*/
+    std::vector<xmlNodePtr> elements;
+
+    /*Names of elements , '<' before children , ',' between siblings , '>' after children*/
+    std::string skeleton;
+
+    /*FNV-1a hash of skeleton*/
+    uint64_t hash;
+
+    /*false if the document is too large or is a request (has an <operation> element)*/
+    bool plannable;
+};
+
+/*
+ * Struct RowPlan
+ * One row of an insert plan : the table and the elements that hold its values.
+ */
+struct RowPlan
+{
+    std::string tableName;
+    std::vector<std::string> names;
+
+    /*Indexes in DocumentShape::elements*/
+    std::vector<size_t> valueElements;
+};
+
+/*
+ * Struct InsertPlan
+ * The rows of an insert document , in the order of Parser::collectDocumentRows.
+ */
+struct InsertPlan
+{
+    std::string skeleton;
+    std::string mainTable;
+
+    /*Index of the uuid element in DocumentShape::elements*/
+    size_t uuidElement;
+
+    std::vector<RowPlan> rows;
+};
+
+/*
+ * Class PlanCache
+ *
+ * Insert plans by document shape , shared by all workers.
+ * A document whose shape is cached is stored without building a tree and
+ * without classifying its nodes : its values are read from the elements
+ * given by the plan.
+ */
+class PlanCache
+{
+public:
+    /*
+     * @brief Construct a new PlanCache object.
+     * @param max number of plans (0 -> disabled).
+     */
+    PlanCache(size_t capacity);
+
+    /*
+     * @brief Fills document with the rows of the plan of shape.
+     * @param shape of a parsed document , document to fill.
+     * @return false if no plan is cached for shape.
+     * @warning throws ParseXmlException if the uuid of the document is empty.
+     */
+    bool extract(const DocumentShape &shape, SQLite::DocumentRows &document);
+
+    /*
+     * @brief Adds a plan , a full cache drops one plan first.
+     * @param plan
+     */
+    void store(std::shared_ptr<InsertPlan> plan, uint64_t hash);
+
+    /*Setters*/
+    void setCapacity(size_t capacity);
+
+    /*Getters*/
+    size_t getCapacity();
+
+private:
+    std::mutex cacheMtx;
+
+    std::unordered_map<uint64_t, std::shared_ptr<InsertPlan>> plans;
+
+    size_t capacity;
+
+    /*
+     * @brief Returns the text content of element.
+     */
+    static std::string elementContent(xmlNodePtr element);
+};
+
+} /*namespace XML*/
+#endif
@@ -10,6 +10,8 @@
 #ifndef TREE_H
 #define TREE_H
 
+#include "compression.hpp"
+
 #include <cstring>
 #include <iostream>
 #include <libxml/parser.h>
@@ -23,6 +25,8 @@
 namespace XML
 {
 
+class ParserContext;
+
 /*
  * Class Node
  * Type of nodes :
@@ -113,9 +117,26 @@ class Tree
 public:
     /*
      * @brief Construct a new Tree object.
-     * @param xmlData
+     * @param xmlData , parser context of the calling worker
+     */
+    Tree(const std::string &xmlData, ParserContext *context);
+
+    /*
+     * @brief Construct a new Tree object from a buffer that is not copied
+     * (for example a memory mapped file).
+     * @param xmlData , size of data , parser context of the calling worker ,
+     * compression of data.
+     * @note the buffer is only read while the constructor runs.
+     */
+    Tree(const char *xmlData, size_t xmlDataSize, ParserContext *context,
+         Compression compression = Compression::none);
+
+    /*
+     * @brief Construct a new Tree object from a parsed document.
+     * @param parsed document (the tree frees it , also if the constructor throws) ,
+     * size of the document.
      */
-    Tree(std::string &xmlData);
+    Tree(xmlDocPtr xmlDoc, size_t documentSize);
 
     /*
      * @brief Destruct a Tree object
@@ -131,10 +152,16 @@ public:
 
     /*Getters*/
     bool getIsSelectType() const;
+    bool getIsStatsType() const;
+    bool getIsTraceType() const;
+    bool getIsChangesType() const;
+    const std::vector<std::pair<std::string, long long>> &getWatermarks() const;
     const std::string &getUuid() const;
     const std::string &getMainTable() const;
     Node *getRoot();
     const std::string &getTableName() const;
+    const std::string &getFormat() const;
+    size_t getNodeCount() const;
 
 private:
     xmlDocPtr xmlDoc;
@@ -147,12 +174,34 @@ private:
 
     std::string mainTable;
 
-    std::string xmlData;
+    /*Input buffer , only valid while the tree is being constructed*/
+    const char *xmlData;
+    size_t xmlDataSize;
+
+    /*Reused libxml2 context of the worker that builds this tree*/
+    ParserContext *context;
+
+    Compression compression;
+
+    /*Size of the parsed document (inflated size for compressed data)*/
+    size_t documentSize;
 
     bool isSelectType;
 
+    bool isStatsType;
+
+    bool isTraceType;
+
+    bool isChangesType;
+
     std::string tableName;
 
+    /*Tables of a changes request with the rowid after which rows are returned*/
+    std::vector<std::pair<std::string, long long>> watermarks;
+
+    /*Output format of a select (format attribute of <operation> , empty -> xml)*/
+    std::string format;
+
     /*
      *
      *
@@ -163,7 +212,7 @@ private:
 
     /*
      * @brief This method reads XML data from the `xmlData` member variable,
-     * parses it using libxml2,
+     * parses it using libxml2 (if the document is not parsed yet),
      * constructs the tree structure,
      * determines the type of the XML document(SELECT OR INSERT),
      * retrieves the UUID if it exists,
@@ -187,11 +236,37 @@ private:
     Node *buildTree(xmlNodePtr xmlNode);
 
     /*
-     * @brief Determines the type of the XML operation(select or insert).
-     * Updates the isSelectType.
+     * @brief Non-Recursively builds the subtree below root.
+     *
+     * @param
+     * -root a node whose children are not built yet.
+     * -nodes list that keeps every created node (to be freed later).
+     */
+    void buildSubtree(Node *root, std::vector<Node *> &nodes);
+
+    /*
+     * @brief Creates the element children of node and links them as siblings.
+     *
+     * @param node , list that keeps every created node.
+     */
+    void addChildren(Node *node, std::vector<Node *> &nodes);
+
+    /*
+     * @brief Determines the type of the XML operation(select , changes , stats , trace
+     * or insert).
+     * Updates the isSelectType , isChangesType , isStatsType , isTraceType , format and
+     * watermarks.
+     * @warning throws ParseXmlException if the format attribute is not xml , json
+     * or binary , or an after attribute is not a rowid.
      */
     void determineType();
 
+    /*
+     * @brief Returns the after attribute of a <table> element of a changes operation.
+     * @warning throws ParseXmlException if it is not a rowid.
+     */
+    long long readWatermark(Node *tableNode);
+
     /*
      * @brief Non-Recursively searches for a node with the given name
      * @param node->root , name of node
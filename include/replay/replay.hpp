@@ -0,0 +1,132 @@
+/**
+ *
+ * \file replay.hpp
+ *
+ * replays a capture file of the server (capturePath) against a running server.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "capture.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * @struct ReplayOptions
+ * @brief options of dbm-replay.
+ */
+struct ReplayOptions
+{
+    std::string capturePath;
+
+    std::string ip = "127.0.0.1";
+    int port = 8080;
+
+    /*Connects to this AF_UNIX socket instead of ip and port if not empty*/
+    std::string unixPath;
+
+    /*
+     * Speed relative to the capture : 1 -> original timing , 2 -> twice as fast ,
+     * 0 -> every request is sent as soon as the previous answer arrived.
+     */
+    double speed = 1.0;
+};
+
+/*
+ * @class Replayer
+ * @brief sends the requests of a capture file to a server with the original
+ * connection concurrency.
+ *
+ * Every connection of the capture is replayed by its own thread on its own
+ * connection , its requests keep their order and (scaled) time since the start
+ * of the capture. A request is sent when its time comes and the answer of the
+ * previous request of its connection has arrived.
+ */
+class Replayer
+{
+public:
+    /*
+     * @brief Construct a new Replayer object , reads the whole capture file.
+     * @param options of the replay.
+     * @warning This method throws a runtime_error if the capture cannot be read.
+     */
+    Replayer(const ReplayOptions &options);
+
+    /*
+     * @brief replays the capture and prints the answers and latencies.
+     */
+    void run();
+
+private:
+    struct Request
+    {
+        /*Microseconds since the start of the capture , server downtime left out*/
+        uint64_t offset;
+
+        XML::Compression compression;
+        std::string body;
+    };
+
+    ReplayOptions options;
+
+    /*Requests of every connection of the capture by session and connection id , in order*/
+    std::map<std::pair<uint32_t, uint32_t>, std::vector<Request>> connections;
+
+    size_t requestCount;
+
+    /*Sessions (server runs) of the capture*/
+    uint32_t sessionCount;
+
+    std::chrono::steady_clock::time_point start;
+
+    /*Answers by kind*/
+    std::atomic<long long> stored;
+    std::atomic<long long> duplicates;
+    std::atomic<long long> errors;
+    std::atomic<long long> rejected;
+    std::atomic<long long> others;
+
+    /*Requests not answered (connection closed or failed)*/
+    std::atomic<long long> failed;
+
+    std::mutex latencyMtx;
+
+    /*Microseconds from sending a request to its whole answer*/
+    std::vector<long long> latencies;
+
+    /*
+     * @brief replays the requests of one connection.
+     */
+    void replayConnection(const std::vector<Request> &requests);
+
+    /*
+     * @brief sends a request on an open connection and reads its answer.
+     * @param socket , unread input of the connection , request , string for the answer.
+     * @return false if the connection is closed.
+     */
+    bool sendRequest(int socket, std::string &input, const Request &request,
+                     std::string &answer);
+
+    /*@brief counts an answer by its kind*/
+    void countAnswer(const std::string &answer);
+
+    /*
+     * @brief opens a connection to the server (ip and port , or unixPath).
+     * @return socket , -1 if the server cannot be reached.
+     */
+    int connectToServer();
+
+    /*@brief prints the summary of the replay*/
+    void printReport(double seconds);
+};
+#endif
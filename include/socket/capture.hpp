@@ -0,0 +1,157 @@
+/**
+ *
+ * \file capture.hpp
+ *
+ * capture file of the requests received by the server , read by dbm-replay.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "compression.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+/*
+ * Capture file :
+ * "DBMC" , version (1 byte) , then one record for each request :
+ * timestamp (u64 , microseconds since the epoch) , connection id (u32) ,
+ * compression (u8 : 0 none , 1 deflate , 2 gzip) , size (u32) and the body as received.
+ * Numbers are little endian.
+ * A record with connection id 0 and no body starts a session : it is written every
+ * time a file is opened for recording , connection ids (which restart at 1 with every
+ * server start) and times belong to the session they follow.
+ */
+
+/*Connection id of the record that starts a session*/
+const uint32_t captureSessionConnection = 0;
+
+/*
+ * @struct CaptureRecord
+ * @brief one request of a capture file.
+ */
+struct CaptureRecord
+{
+    uint64_t timestamp;
+    uint32_t connection;
+    XML::Compression compression;
+    std::string body;
+
+    /*@brief whether the record starts a session (it is not a request)*/
+    bool isSessionStart() const
+    {
+        return connection == captureSessionConnection;
+    }
+};
+
+/*
+ * @class CaptureWriter
+ * @brief appends the requests received by the server to a capture file.
+ * Records are written by the client threads , a mutex keeps them whole.
+ */
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+
+    /*
+     * @brief Destruct a CaptureWriter object , the file is flushed and closed.
+     */
+    ~CaptureWriter();
+
+    /*
+     * @brief Closes the current file and starts a new session at the end of path.
+     * A record cut by a crash at the end of an existing file is removed first.
+     * @param path of the capture file (empty -> recording stops).
+     * @warning This method throws a runtime_error if the file cannot be opened , or is
+     * not empty and does not start with the header of this version , recording is
+     * stopped then.
+     */
+    void setPath(const std::string &path);
+
+    /*
+     * @brief Appends a request , does nothing (and does not lock) if no file is open.
+     * @param connection id , compression and body of the request.
+     */
+    void record(uint32_t connection, XML::Compression compression, const char *body,
+                size_t size);
+
+    /*
+     * @brief Appends a request with the given time (generated captures).
+     * @param timestamp in microseconds , connection id , compression and body.
+     */
+    void recordAt(uint64_t timestamp, uint32_t connection, XML::Compression compression,
+                  const char *body, size_t size);
+
+    /*@brief writes buffered records to the file (called about once a second)*/
+    void flush();
+
+    /*Getters*/
+    bool isRecording();
+    std::string getPath();
+
+private:
+    /*Set while a file is open , checked without locking*/
+    std::atomic<bool> recording;
+
+    std::mutex captureMtx;
+
+    FILE *file;
+
+    std::string path;
+
+    /*@brief flushes and closes the file , the caller must hold captureMtx*/
+    void closeLocked();
+
+    /*
+     * @brief Checks the header of the open file and removes a cut record at its end ,
+     * the caller must hold captureMtx.
+     * @param size of the file
+     * @warning This method throws a runtime_error if the header is not of this version.
+     */
+    void repairLocked(long size);
+
+    /*@brief appends a record , the caller must hold captureMtx*/
+    void writeLocked(uint64_t timestamp, uint32_t connection, XML::Compression compression,
+                     const char *body, size_t size);
+};
+
+/*
+ * @class CaptureReader
+ * @brief reads the records of a capture file in order.
+ */
+class CaptureReader
+{
+public:
+    /*
+     * @brief Construct a new CaptureReader object.
+     * @param path of the capture file.
+     * @warning This method throws a runtime_error if the file cannot be opened or
+     * is not a capture file.
+     */
+    CaptureReader(const std::string &path);
+
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader &) = delete;
+    CaptureReader &operator=(const CaptureReader &) = delete;
+
+    /*
+     * @brief Reads the next record.
+     * @return false at the end of the file.
+     * @warning This method throws a runtime_error if the last record is truncated.
+     */
+    bool next(CaptureRecord &record);
+
+private:
+    FILE *file;
+};
+#endif
@@ -9,7 +9,13 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#include "compression.hpp"
+#include "lock.hpp"
+#include "writer.hpp"
+
 #include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstring>
 #include <iostream>
@@ -44,47 +50,97 @@ public:
     /*Getters*/
     bool getResultReady() const;
     bool getDataReady() const;
-    std::mutex &getMutex();
-    std::condition_variable &getCV();
+    InstrumentedMutex &getMutex();
+    InstrumentedCondition &getCV();
     std::thread &getThread();
-    std::thread &getParseThread();
     int getId() const;
     int getClientSocket() const;
     const std::string& getInputData() ;
-    const std::string& getResult() ;
+    XML::Compression getCompression() const;
+    ResponseWriter &getWriter();
+    bool isDisconnected() const;
+    bool hasDeadline() const;
+    std::chrono::steady_clock::time_point getDeadline() const;
+    std::vector<char> &getReadBuffer();
+    uint64_t getTraceId() const;
+    std::chrono::steady_clock::time_point getQueuedAt() const;
 
     /*Setters*/
     void setResultReady(bool resultReady);
     void setDataReady(bool dataReady);
     void setThread(std::thread &&thread);
-    void setParseThread(std::thread &&thread);
     void setId(int id);
     void setClientSocket(int clientSocket);
-    void setInputData(const std::string &inputData);
-    void setResult(const std::string &result);
+    void setInputData(const char *inputData, size_t size);
+    void setCompression(XML::Compression compression);
+    void setDisconnected(bool disconnected);
+    void setTraceId(uint64_t traceId);
+    void setQueuedAt(std::chrono::steady_clock::time_point queuedAt);
+
+    /*
+     * @brief Sets the time until which the current read must complete.
+     * @param timeout in milliseconds from now , 0 -> no deadline
+     */
+    void setDeadline(int timeout);
+
+    /*
+     * @brief Moves the result of the request into the client and marks it ready.
+     */
+    void setResult(std::string &&result);
+
+    /*
+     * @brief Moves the result out of the client , for the writer.
+     */
+    std::string takeResult();
 
     /* Resets the client state for reuse*/
     void reset();
 
+    /*
+     * @brief Prepares a closed client for a new connection , keeps the allocated
+     * buffers (large buffers are released).
+     * @param socket , id of the new connection
+     * @warning the thread of the previous connection must be joined.
+     */
+    void recycle(int socket, int id);
+
 private:
     int clientSocket;
 
     std::string inputData;
 
+    /*Buffer for the request body , reused by the following requests*/
+    std::vector<char> readBuffer;
+
+    /*Compression of inputData , from the request header*/
+    XML::Compression compression;
+
     int id;
 
     std::thread clientThread;
 
-    std::thread parseThread;
-
     std::string result;
 
-    std::mutex clientMtx;
+    /*Queued output to the client socket*/
+    ResponseWriter writer;
+
+    InstrumentedMutex clientMtx {"clientMtx"};
 
-    std::condition_variable cv;
+    InstrumentedCondition cv;
 
     bool resultReady;
 
     bool dataReady;
+
+    /*Set when the client closed the connection or cannot receive data*/
+    std::atomic<bool> disconnected;
+
+    /*Deadline of the current read , only valid if withDeadline*/
+    std::chrono::steady_clock::time_point deadline;
+    bool withDeadline;
+
+    /*Trace id of the current request (0 -> not sampled) , and when it was queued*/
+    uint64_t traceId;
+    std::chrono::steady_clock::time_point queuedAt;
 };
 #endif
@@ -0,0 +1,84 @@
+/**
+ *
+ * \file dedup.hpp
+ *
+ * answers of recently stored payloads.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "compression.hpp"
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*
+ * @class PayloadCache
+ * @brief least recently used answers of stored payloads , by hash of the payload.
+ *
+ * A producer that sends a byte-identical payload again gets the cached answer at
+ * once , the payload is not parsed and the database is not used.
+ * A payload is identified by its SHA-256 digest and its compression , a resend is only
+ * answered from the cache if both are equal (a weak hash could drop a new document).
+ */
+class PayloadCache
+{
+public:
+    /*
+     * @brief Construct a new PayloadCache object.
+     * @param max number of payloads (0 -> disabled).
+     */
+    PayloadCache(size_t capacity);
+
+    /*
+     * @brief Returns the SHA-256 digest of data (32 bytes).
+     */
+    static std::string digest(const char *data, size_t size);
+
+    /*
+     * @brief Looks up a payload , a found payload becomes the most recently used.
+     * @param digest and compression of payload , string to store the answer.
+     * @return true if the payload was found.
+     */
+    bool find(const std::string &digest, XML::Compression compression, std::string &answer);
+
+    /*
+     * @brief Adds the answer of a payload , the least recently used payload is
+     * dropped when the cache is full.
+     */
+    void store(const std::string &digest, XML::Compression compression,
+               const std::string &answer);
+
+    /*Setters*/
+    void setCapacity(size_t capacity);
+
+    /*Getters*/
+    size_t getCapacity();
+
+private:
+    struct Entry
+    {
+        std::string digest;
+        XML::Compression compression;
+        std::string answer;
+    };
+
+    std::mutex cacheMtx;
+
+    /*Most recently used first*/
+    std::list<Entry> entries;
+
+    /*Entries by digest*/
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+    size_t capacity;
+};
+
+#endif
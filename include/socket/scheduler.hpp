@@ -0,0 +1,118 @@
+/**
+ *
+ * \file scheduler.hpp
+ *
+ * queues of requests waiting for a worker.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "client.hpp"
+#include "compression.hpp"
+#include "lock.hpp"
+
+#include <deque>
+#include <vector>
+
+/*
+ * @enum RequestClass
+ * @brief kind of a request for scheduling.
+ * insert -> xml data to store (and stats or trace requests) , short and frequent.
+ * select -> a select (or changes) of one or all tables , may keep a worker busy for a
+ * long time.
+ */
+enum class RequestClass
+{
+    insert,
+    select
+};
+
+/*
+ * @class RequestScheduler
+ * @brief one queue for each request class and the order in which workers take them.
+ *
+ * A few selects of all tables must not delay thousands of inserts behind them :
+ * 1.When both classes wait , a select is taken after selectWeight inserts , so
+ *   waiting selects get a share of the workers and are not starved.
+ * 2.At most maxSelectWorkers selects are processed at the same time , the other
+ *   workers stay free for inserts.
+ * The time every request waited in its queue is recorded in the histograms
+ * queue.insert.wait and queue.select.wait.
+ *
+ * Not thread safe , the caller holds socketMtx.
+ */
+class RequestScheduler
+{
+public:
+    /*
+     * @brief Construct a new RequestScheduler object.
+     * @param selectWeight (inserts taken before a select , at least 1) ,
+     * maxSelectWorkers (0 -> no limit)
+     */
+    RequestScheduler(int selectWeight, int maxSelectWorkers);
+
+    /*
+     * @brief Returns the class of a request body , without parsing it.
+     * @param data , size of data , compression of data
+     */
+    static RequestClass classify(const char *data, size_t size, XML::Compression compression);
+
+    /*
+     * @brief Queues the client of a request , the client must have its queue time set.
+     * @param client , class of its request
+     */
+    void push(Client *client, RequestClass requestClass);
+
+    /*
+     * @brief Takes the next request a worker may process now.
+     * @param requestClass is set to the class of the request.
+     * @return the client , nullptr if no request can be taken.
+     */
+    Client *pop(RequestClass &requestClass);
+
+    /*
+     * @brief Marks a request taken by pop as processed.
+     * @return true if a waiting select can be taken now.
+     */
+    bool finished(RequestClass requestClass);
+
+    /*
+     * @brief Removes all waiting requests (a draining server cancels them).
+     */
+    std::vector<Client *> takeAll();
+
+    /*@brief whether pop would return a request*/
+    bool hasRunnable() const;
+
+    /*Getters*/
+    bool empty() const;
+
+    /*Setters*/
+    void setSelectWeight(int selectWeight);
+    void setMaxSelectWorkers(int maxSelectWorkers);
+
+private:
+    std::deque<Client *> inserts;
+    std::deque<Client *> selects;
+
+    int selectWeight;
+    int maxSelectWorkers;
+
+    /*Inserts taken since the last select , while selects were waiting*/
+    int insertsTaken;
+
+    /*Selects taken and not finished*/
+    int runningSelects;
+
+    /*Histograms of the queue wait of each class*/
+    LockHistogram &insertWait;
+    LockHistogram &selectWait;
+
+    /*@brief whether a select may be taken (below maxSelectWorkers)*/
+    bool canTakeSelect() const;
+};
+#endif
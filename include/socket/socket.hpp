@@ -10,8 +10,11 @@
 #ifndef SOCKET_H
 #define SOCKET_H
 
+#include "capture.hpp"
 #include "client.hpp"
 #include "config.hpp"
+#include "dedup.hpp"
+#include "scheduler.hpp"
 
 /**
  * @ class socket
@@ -40,9 +43,28 @@ public:
     /*@brief close server*/
     void stop();
 
+    /*
+     * @brief stops accepting clients and waits (at most timeout milliseconds) for
+     * queued and in-flight requests , requests still queued after the timeout are
+     * answered without processing. Then the client connections are shut down.
+     * @param timeout in milliseconds
+     */
+    void drain(int timeout);
+
+    /*
+     * @brief applies the runtime settings of a reloaded configuration (timeouts ,
+     * admission limits , write watermark). New values apply to the next read ,
+     * request or connection.
+     * @param object of ServerConfiguration
+     */
+    void applyConfiguration(const ServerConfiguration &serverConfig);
+
     /*@brief checks whether socket is open or not*/
     bool isOpen();
 
+    /*@brief writes the buffered records of the capture file*/
+    void flushCapture();
+
     /*
      * @brief Creates a socket for  the server using the provided
      * configuration.
@@ -60,9 +82,9 @@ public:
     /*Getters*/
     int getSockfd() const;
     const std::vector<Client *> &getClients();
-    std::queue<Client *> &getWaitingClients();
-    std::mutex &getMutex();
-    std::condition_variable &getCV();
+    RequestScheduler &getScheduler();
+    InstrumentedMutex &getMutex();
+    InstrumentedCondition &getCV();
 
 private:
     /* IP */
@@ -71,9 +93,59 @@ private:
     /* Port */
     int port;
 
-    /*Max clients that can connect*/
+    /*Path of the AF_UNIX listener (empty -> TCP only)*/
+    std::string unixPath;
+
+    /*Backlog of the listening socket (connections not accepted yet)*/
     int maxConnection;
 
+    /*
+     * Runtime settings , atomic because a reload changes them while client
+     * threads read them.
+     */
+
+    /*Max connected clients*/
+    std::atomic<int> maxClients;
+
+    /*Max requests queued or being processed*/
+    std::atomic<int> maxInFlight;
+
+    /*Milliseconds a request waits for an in-flight slot*/
+    std::atomic<int> admissionWait;
+
+    /*Read deadlines in milliseconds (see ServerConfiguration)*/
+    std::atomic<int> headerTimeout;
+    std::atomic<int> bodyTimeout;
+    std::atomic<int> idleTimeout;
+
+    /*Listening sockets , one for each acceptor thread (TCP acceptors , then unix)*/
+    int acceptors;
+    std::vector<int> listeners;
+
+    /*Threads of acceptors 1..n-1 (acceptor 0 runs in the thread of createSocket)*/
+    std::vector<std::thread> acceptorThreads;
+
+    /*Number of connected clients*/
+    std::atomic<int> activeClients;
+
+    /*Number of requests queued or being processed (guarded by socketMtx)*/
+    int inFlight;
+
+    /*Notified when an in-flight slot is released*/
+    InstrumentedCondition inFlightCV;
+
+    /*Pending output of a client above which producing stops (bytes)*/
+    std::atomic<size_t> writeHighWatermark;
+
+    /*Milliseconds a client may refuse data before it is closed*/
+    std::atomic<int> writeTimeout;
+
+    /*Answers of recently stored payloads*/
+    PayloadCache payloadCache;
+
+    /*Capture file of the received requests (capturePath)*/
+    CaptureWriter capture;
+
     /*Socket discriptor*/
     int sockfd;
 
@@ -84,20 +156,26 @@ private:
     bool isListening;
 
     /*Mutex*/
-    std::mutex socketMtx;
-    std::mutex coutMtx;
+    InstrumentedMutex socketMtx {"socketMtx"};
+    InstrumentedMutex coutMtx {"coutMtx"};
 
     /*Condition variable*/
-    std::condition_variable cv;
+    InstrumentedCondition cv;
 
-    /*Number of clients*/
+    /*Number of clients (guarded by socketMtx)*/
     int clientsNum;
 
-    /*Vector to store clients*/
+    /*Vector to store connected clients*/
     std::vector<Client *> clients;
 
-    /*Queue to store clients waiting for a response*/
-    std::queue<Client *> waitingClients;
+    /*Closed clients whose threads are not joined yet (guarded by socketMtx)*/
+    std::vector<Client *> finishedClients;
+
+    /*Joined clients ready to be reused for new connections (guarded by socketMtx)*/
+    std::vector<Client *> freeClients;
+
+    /*Queues of clients waiting for a worker (guarded by socketMtx)*/
+    RequestScheduler scheduler;
 
     /**
      *
@@ -112,36 +190,66 @@ private:
      */
     sockaddr_in setup();
 
+    /*
+     * @brief creates , binds and listens a listening socket (SO_REUSEPORT if
+     * there are several acceptors).
+     * @param sockaddr
+     * @return the listening socket
+     * @warning this method throws a SocketException if the socket cannot be created ,
+     * bound or listened.
+     */
+    int createListener(sockaddr_in address);
+
+    /*
+     * @brief creates , binds and listens the AF_UNIX listening socket at unixPath.
+     * @return the listening socket
+     * @warning this method throws a SocketException if the path is too long or is
+     * not a socket , or the socket cannot be created , bound or listened.
+     */
+    int createUnixListener();
+
+    /*
+     * @brief shuts down and closes all listening sockets , removes the unix socket file.
+     */
+    void closeListeners();
+
     /*
      * @brief binding socket
      *
-     * @param sockaddr , length of address
+     * @param listening socket , sockaddr , length of address
      *
      * @warning this method throws a SocketException if :
      * The socket binding failes.
      *
      * */
-    void bindSocket(sockaddr_in address, int addressLen);
+    void bindSocket(int listener, sockaddr_in address, int addressLen);
 
     /*
      * @brief listen on socket
      *
+     * @param listening socket
      *
      * @warning this method throws SocketException if:
      * The listening on the socket failes.
      */
-    void listenForClients();
+    void listenForClients(int listener);
 
     /*
      * @brief accept client
      *
-     * @param sockaddr_in , length of address
+     * @param index of acceptor (and of its listening socket)
      *
      * @warning this method throws SocketException if:
      * Accepting incoming client connections fails.
      *
      */
-    void acceptClient(sockaddr_in address, int addressLen);
+    void acceptClient(int acceptor);
+
+    /*
+     * @brief runs acceptClient in an acceptor thread , stops the server on error.
+     * @param index of acceptor
+     */
+    void runAcceptor(int acceptor);
 
     /*
      *@brief handle client -> read data length and read data.
@@ -164,6 +272,29 @@ private:
      */
     int readData(Client *client, char *buffer, int size);
 
+    /*
+     * @brief reads available data from the non-blocking client socket ,
+     * waits while no data is available.
+     * @param instance of client , buffer , size of buffer
+     * @return bytes of read , -1 if the client closed the connection or failed.
+     */
+    int readFromClient(Client *client, char *buffer, int size);
+
+    /*
+     * @brief waits until the client socket is readable , at most until the
+     * deadline of the client.
+     * @param instance of client
+     * @return false on error or when the deadline expired
+     */
+    bool waitReadable(Client *client);
+
+    /*
+     * @brief queues message and writes all pending output of the client.
+     * @param instance of client , message
+     * @return false if the client cannot receive data (it is marked as disconnected).
+     */
+    bool sendToClient(Client *client, const std::string &message);
+
     /*
      * @brief read one character from client(client choice)
      * @param instance of client
@@ -198,10 +329,53 @@ private:
     void closeClient(Client *client);
 
     /*
-     * @brief push client to waiting clients
-     * @param instance of client
+     * @brief push client to the queue of its request class
+     * @param instance of client , class of its request
+     */
+    void pushToQueue(Client *client, RequestClass requestClass);
+
+    /*
+     * @brief returns a client for a new connection , reuses a free client if
+     * there is one.
+     * @param socket of the new connection
+     */
+    Client *obtainClient(int clientSocket);
+
+    /*
+     * @brief joins the threads of finished clients and moves them to the free clients.
+     */
+    void reclaimClients();
+
+    /*
+     * @brief rejects a new connection because too many clients are connected.
+     * @param socket of the new connection
+     */
+    void rejectConnection(int clientSocket);
+
+    /*
+     * @brief waits (at most admissionWait) for a free in-flight slot and takes it.
+     * @return false if no slot became free , the request must be rejected.
+     */
+    bool acquireRequestSlot();
+
+    /*
+     * @brief releases the in-flight slot of a finished request.
+     */
+    void releaseRequestSlot();
+
+    /*
+     * @brief passes the data to the workers and waits for the result (Client::takeResult).
+     * @param client , data , size of data
+     * @return false if the request was rejected (no free in-flight slot).
+     */
+    bool processRequest(Client *client, const char *data, int size);
+
+    /*
+     * @brief starts , moves or stops the capture of requests.
+     * @param path of capture file (empty -> no capture)
+     * @warning This method throws a runtime_error if the file cannot be opened.
      */
-    void pushToQueue(Client *client);
+    void setCapturePath(const std::string &path);
 };
 /*
  * To handel socket exceptions
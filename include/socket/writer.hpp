@@ -0,0 +1,125 @@
+/**
+ *
+ * \file writer.hpp
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <deque>
+#include <string>
+#include <sys/types.h>
+
+/*
+ * @class ResponseWriter
+ * @brief queues the output of one connection and writes it to a non-blocking socket.
+ *
+ * Partial writes and EAGAIN are handled by keeping the rest of the data in the queue
+ * and waiting (poll) until the socket is writable again.
+ * The queued chunks are written with one sendmsg (a gathered write) , so an answer and
+ * the prompt after it leave in one system call without being concatenated.
+ * Owned data (std::string &&) is moved into the queue. Large borrowed data is sent
+ * directly behind the queued chunks , only the part the socket does not accept is copied.
+ * When the pending output grows above the high watermark write flushes before
+ * accepting more data , so whoever produces the output waits for a slow client
+ * instead of buffering without limit. A producer that must not wait while it holds a
+ * lock uses queue , checks isFull and calls drain after releasing the lock.
+ * A client that does not accept any data for writeTimeout milliseconds is
+ * considered dead and the writer fails.
+ */
+class ResponseWriter
+{
+public:
+    /*
+     * @brief Construct a new ResponseWriter object (not attached to a socket).
+     */
+    ResponseWriter();
+
+    /*
+     * @brief Attaches the writer to a socket and clears pending output.
+     * @param socket , high watermark in bytes , write timeout in milliseconds
+     */
+    void reset(int socket, size_t highWatermark, int writeTimeout);
+
+    /*
+     * @brief Queues data , flushes first when the pending output is above the high watermark.
+     * Borrowed data of writerCopySize bytes or more is written at once with the queued chunks.
+     * @param data , size of data
+     * @return false if the client failed (closed or timed out)
+     */
+    bool write(const char *data, size_t size);
+    bool write(const std::string &data);
+    bool write(std::string &&data);
+
+    /*
+     * @brief Queues data like write , but never waits for the client.
+     * @param data , size of data
+     * @return false if the client failed (closed)
+     */
+    bool queue(const char *data, size_t size);
+
+    /*
+     * @brief Writes pending output until it is below half of the high watermark.
+     * @return false if the client failed (closed or timed out)
+     */
+    bool drain();
+
+    /*@brief whether the pending output is above the high watermark*/
+    bool isFull() const;
+
+    /*
+     * @brief Writes all pending output.
+     * @return false if the client failed (closed or timed out)
+     */
+    bool flush();
+
+    /*Getters*/
+    size_t getPendingBytes() const;
+    bool isFailed() const;
+
+private:
+    int socket;
+
+    /*Queued output , the first chunk may be partially written*/
+    std::deque<std::string> chunks;
+
+    /*Bytes of the first chunk already written*/
+    size_t offset;
+
+    size_t pendingBytes;
+
+    size_t highWatermark;
+
+    int writeTimeout;
+
+    bool failed;
+
+    /*
+     * @brief Writes pending output until at most limit bytes are pending.
+     * @return false if the client failed
+     */
+    bool flushTo(size_t limit);
+
+    /*
+     * @brief Writes the queued chunks and then extra with one sendmsg , removes the
+     * written chunks.
+     * @param extra , size of extra (borrowed data that follows the queue)
+     * @return the number of bytes of extra written , -1 on error (errno is set)
+     */
+    ssize_t sendQueued(const char *extra, size_t extraSize);
+
+    /*
+     * @brief Removes size written bytes from the front of the queue.
+     */
+    void consume(size_t size);
+
+    /*
+     * @brief Waits until the socket is writable.
+     * @return false on timeout or error
+     */
+    bool waitWritable();
+};
+#endif
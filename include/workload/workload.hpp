@@ -0,0 +1,114 @@
+/**
+ *
+ * \file workload.hpp
+ *
+ * reproducible xml documents and select requests for benchmarks and stress tests.
+ *
+ * \author : MohammadDerhami
+ *
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * @struct WorkloadShape
+ * @brief shape of the generated documents.
+ *
+ * A document is a root with one main table element (t0 , t1 , ...) that holds the
+ * uuid , properties and nested objects :
+ * <root><t0><uuid>..</uuid><p0>..</p0><t0_1><p0>..</p0><t0_2>..</t0_2></t0_1></t0></root>
+ * Every object has the same properties , so each element name is one table with
+ * fixed columns.
+ */
+struct WorkloadShape
+{
+    /*Same seed and shape -> same documents*/
+    uint64_t seed = 1;
+
+    /*Main tables , documents use them in turn*/
+    int tables = 1;
+
+    /*Levels of nested objects below the main table*/
+    int depth = 2;
+
+    /*Child objects of every object (rows of the nested table)*/
+    int fanOut = 2;
+
+    /*Properties of every object*/
+    int properties = 4;
+
+    /*Characters of every value*/
+    int valueSize = 16;
+
+    /*Fraction of documents that are a byte-identical resend of an earlier document*/
+    double duplicateRatio = 0.0;
+};
+
+/*
+ * @class WorkloadGenerator
+ * @brief generates documents of a shape and select requests of their tables.
+ */
+class WorkloadGenerator
+{
+public:
+    /*
+     * @brief Construct a new WorkloadGenerator object.
+     * @param shape of documents.
+     * @warning This method throws an invalid_argument if a value of shape is out of range ,
+     * or if depth and fanOut give more than workloadMaxObjects objects per document.
+     */
+    WorkloadGenerator(const WorkloadShape &shape);
+
+    /*
+     * @brief Returns the next insert document.
+     * @param duplicate is set to whether it is a resend of an earlier document.
+     */
+    std::string nextDocument(bool &duplicate);
+    std::string nextDocument();
+
+    /*
+     * @brief Returns a select request of one table (empty -> all tables).
+     * @param table , format (xml , json or binary).
+     */
+    static std::string selectRequest(const std::string &table, const std::string &format = "xml");
+
+    /*
+     * @brief Returns a select request of a random table of the schema.
+     */
+    std::string randomSelectRequest(const std::string &format = "xml");
+
+    /*Getters*/
+
+    /*Names of all tables of the schema (main and nested)*/
+    const std::vector<std::string> &getTableNames() const;
+
+private:
+    WorkloadShape shape;
+
+    std::mt19937_64 random;
+
+    std::vector<std::string> tableNames;
+
+    /*Recent documents , resent as duplicates*/
+    std::deque<std::string> history;
+
+    /*Documents generated so far (selects the main table)*/
+    uint64_t documents;
+
+    /*@brief appends an object and its nested objects to document*/
+    void appendObject(std::string &document, const std::string &name, int level, bool withUuid);
+
+    /*@brief appends a random value of valueSize characters*/
+    void appendValue(std::string &document);
+
+    /*@brief returns a random uuid (version 4 format)*/
+    std::string randomUuid();
+};
+#endif
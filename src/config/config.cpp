@@ -18,9 +18,144 @@
 /*Configures the application by parsing command-line arguments and loading the configuraion file.*/
 void Configuration::config(int argc, char *argv[])
 {
-    std::string filePath = commandLineArgs(argc, argv);
+    configFilePath = commandLineArgs(argc, argv);
 
-    configurationProgram(filePath);
+    configurationProgram(configFilePath);
+}
+
+/* Prints a changed setting , returns whether it changed*/
+template <typename Value>
+static bool reportChange(const std::string &name, const Value &oldValue, const Value &newValue,
+                         bool needsRestart)
+{
+    if (oldValue == newValue)
+        return false;
+
+    std::cout << "Reload : " << name << " " << oldValue << " -> " << newValue
+              << (needsRestart ? " (needs restart , not applied)" : "") << "\n";
+    return true;
+}
+
+/*
+ * Reloads the configuration file (SIGHUP).
+ * The file is parsed and validated into a new Configuration first , so an invalid
+ * file leaves the running configuration unchanged.
+ *
+ * Runtime settings : timeouts , admission limits , write watermark , workers ,
+ * SQLite tuning pragmas , bulk load batches , cache budgets , capture path , trace sampling
+ * and path.
+ * Restart settings : ip , port , maxConnection , acceptors , unixPath , database path ,
+ * idempotent , parser options , journalMode , trace buffer size.
+ */
+bool Configuration::reload()
+{
+    Configuration fresh;
+    try {
+        fresh.configurationProgram(configFilePath);
+
+    } catch (const std::exception &e) {
+        std::string message = e.what();
+        if (message.empty() || message.back() != '\n')
+            message += "\n";
+
+        std::cerr << "Reload failed , configuration is not changed : " << message;
+        return false;
+    }
+
+    const ServerConfiguration &oldServer = serverConfig;
+    ServerConfiguration server = fresh.serverConfig;
+
+    reportChange("servive.ip", oldServer.getIp(), server.getIp(), true);
+    reportChange("servive.port", oldServer.getPort(), server.getPort(), true);
+    reportChange("servive.maxConnection", oldServer.getMaxConnection(),
+                 server.getMaxConnection(), true);
+    reportChange("servive.acceptors", oldServer.getAcceptors(), server.getAcceptors(), true);
+    reportChange("servive.unixPath", oldServer.getUnixPath(), server.getUnixPath(), true);
+    reportChange("servive.writeHighWatermark", oldServer.getWriteHighWatermark(),
+                 server.getWriteHighWatermark(), false);
+    reportChange("servive.writeTimeout", oldServer.getWriteTimeout(), server.getWriteTimeout(),
+                 false);
+    reportChange("servive.maxClients", oldServer.getMaxClients(), server.getMaxClients(), false);
+    reportChange("servive.maxInFlight", oldServer.getMaxInFlight(), server.getMaxInFlight(),
+                 false);
+    reportChange("servive.admissionWait", oldServer.getAdmissionWait(),
+                 server.getAdmissionWait(), false);
+    reportChange("servive.headerTimeout", oldServer.getHeaderTimeout(),
+                 server.getHeaderTimeout(), false);
+    reportChange("servive.bodyTimeout", oldServer.getBodyTimeout(), server.getBodyTimeout(),
+                 false);
+    reportChange("servive.idleTimeout", oldServer.getIdleTimeout(), server.getIdleTimeout(),
+                 false);
+    reportChange("servive.drainTimeout", oldServer.getDrainTimeout(), server.getDrainTimeout(),
+                 false);
+    reportChange("servive.dedupCacheSize", oldServer.getDedupCacheSize(),
+                 server.getDedupCacheSize(), false);
+    reportChange("servive.capturePath", oldServer.getCapturePath(), server.getCapturePath(),
+                 false);
+    reportChange("servive.selectWeight", oldServer.getSelectWeight(), server.getSelectWeight(),
+                 false);
+    reportChange("servive.maxSelectWorkers", oldServer.getMaxSelectWorkers(),
+                 server.getMaxSelectWorkers(), false);
+
+    reportChange("database.path", databaseConfig.getFilePath(),
+                 fresh.databaseConfig.getFilePath(), true);
+    reportChange("database.idempotent", databaseConfig.getIdempotent(),
+                 fresh.databaseConfig.getIdempotent(), true);
+
+    const ParserConfiguration &parser = fresh.parserConfig;
+    reportChange("parser.compact", parserConfig.getCompact(), parser.getCompact(), true);
+    reportChange("parser.noNet", parserConfig.getNoNet(), parser.getNoNet(), true);
+    reportChange("parser.noBlanks", parserConfig.getNoBlanks(), parser.getNoBlanks(), true);
+    reportChange("parser.huge", parserConfig.getHuge(), parser.getHuge(), true);
+    reportChange("parser.maxInflatedSize", parserConfig.getMaxInflatedSize(),
+                 parser.getMaxInflatedSize(), true);
+
+    const PerformanceConfiguration &oldPerformance = performanceConfig;
+    PerformanceConfiguration performance = fresh.performanceConfig;
+
+    reportChange("performance.journalMode", oldPerformance.getJournalMode(),
+                 performance.getJournalMode(), true);
+    reportChange("performance.synchronous", oldPerformance.getSynchronous(),
+                 performance.getSynchronous(), false);
+    reportChange("performance.cacheSize", oldPerformance.getCacheSize(),
+                 performance.getCacheSize(), false);
+    reportChange("performance.mmapSize", oldPerformance.getMmapSize(), performance.getMmapSize(),
+                 false);
+    reportChange("performance.tempStore", oldPerformance.getTempStore(),
+                 performance.getTempStore(), false);
+    reportChange("performance.busyTimeout", oldPerformance.getBusyTimeout(),
+                 performance.getBusyTimeout(), false);
+    reportChange("performance.workers", oldPerformance.getWorkers(), performance.getWorkers(),
+                 false);
+    reportChange("performance.loaderBatchSize", oldPerformance.getLoaderBatchSize(),
+                 performance.getLoaderBatchSize(), false);
+    reportChange("performance.loaderQueueSize", oldPerformance.getLoaderQueueSize(),
+                 performance.getLoaderQueueSize(), false);
+    reportChange("performance.planCacheSize", oldPerformance.getPlanCacheSize(),
+                 performance.getPlanCacheSize(), false);
+    reportChange("performance.statementCacheSize", oldPerformance.getStatementCacheSize(),
+                 performance.getStatementCacheSize(), false);
+
+    const TraceConfiguration &trace = fresh.traceConfig;
+    reportChange("trace.sampleRate", traceConfig.getSampleRate(), trace.getSampleRate(), false);
+    reportChange("trace.bufferSize", traceConfig.getBufferSize(), trace.getBufferSize(), true);
+    reportChange("trace.path", traceConfig.getPath(), trace.getPath(), false);
+
+    /*Restart settings keep their running value*/
+    server.setIp(oldServer.getIp());
+    server.setPort(oldServer.getPort());
+    server.setMaxConnection(oldServer.getMaxConnection());
+    server.setAcceptors(oldServer.getAcceptors());
+    server.setUnixPath(oldServer.getUnixPath());
+    performance.setJournalMode(oldPerformance.getJournalMode());
+
+    serverConfig = server;
+    performanceConfig = performance;
+
+    traceConfig.setSampleRate(trace.getSampleRate());
+    traceConfig.setPath(trace.getPath());
+
+    return true;
 }
 
 /*Parses command-line arguments to determine the configuraiton file path.*/
@@ -37,7 +172,7 @@ std::string Configuration::commandLineArgs(int argc, char *argv[])
 
     bool configFileProvided = false;
 
-    while ((opt = getopt(argc, argv, ":f:vho")) != -1) {
+    while ((opt = getopt(argc, argv, ":f:i:vho")) != -1) {
         switch (opt) {
         /* -h -> print help */
         case 'h':
@@ -56,6 +191,10 @@ std::string Configuration::commandLineArgs(int argc, char *argv[])
             filePath = optarg;
             configFileProvided = true;
             break;
+        /* -i <path> -> bulk load files instead of starting the server*/
+        case 'i':
+            importPath = optarg;
+            break;
         case ':':
             std::cout << "Error : Option needs a value \n\n";
             printHelp();
@@ -80,6 +219,30 @@ std::string Configuration::commandLineArgs(int argc, char *argv[])
     return filePath;
 }
 
+/* Whether a performance key is set , a value of the wrong type is a typo and stops the program*/
+static bool hasPerformanceValue(const nlohmann::json &performance, const std::string &name,
+                                bool (nlohmann::json::*isType)() const, const std::string &type)
+{
+    if (! performance.contains(name))
+        return false;
+
+    if (! (performance[name].*isType)())
+        throw std::runtime_error("Invalid performance." + name + ": " + performance[name].dump() +
+                                 " (expected " + type + ")\n");
+    return true;
+}
+
+static bool hasPerformanceString(const nlohmann::json &performance, const std::string &name)
+{
+    return hasPerformanceValue(performance, name, &nlohmann::json::is_string, "a string");
+}
+
+static bool hasPerformanceInteger(const nlohmann::json &performance, const std::string &name)
+{
+    return hasPerformanceValue(performance, name, &nlohmann::json::is_number_integer,
+                               "an integer");
+}
+
 /*Opens the specified configurtion file , parse json and initializes the server and database.*/
 void Configuration::configurationProgram(const std::string &configFilePath)
 {
@@ -109,6 +272,53 @@ void Configuration::configurationProgram(const std::string &configFilePath)
         if (service.contains("maxConnection") && service["maxConnection"].is_number_integer()) {
             serverConfig.setMaxConnection(service["maxConnection"].get<int>());
         }
+        if (service.contains("writeHighWatermark") &&
+            service["writeHighWatermark"].is_number_unsigned()) {
+            serverConfig.setWriteHighWatermark(service["writeHighWatermark"].get<size_t>());
+        }
+        if (service.contains("writeTimeout") && service["writeTimeout"].is_number_integer()) {
+            serverConfig.setWriteTimeout(service["writeTimeout"].get<int>());
+        }
+        if (service.contains("maxClients") && service["maxClients"].is_number_integer()) {
+            serverConfig.setMaxClients(service["maxClients"].get<int>());
+        }
+        if (service.contains("maxInFlight") && service["maxInFlight"].is_number_integer()) {
+            serverConfig.setMaxInFlight(service["maxInFlight"].get<int>());
+        }
+        if (service.contains("admissionWait") && service["admissionWait"].is_number_integer()) {
+            serverConfig.setAdmissionWait(service["admissionWait"].get<int>());
+        }
+        if (service.contains("headerTimeout") && service["headerTimeout"].is_number_integer()) {
+            serverConfig.setHeaderTimeout(service["headerTimeout"].get<int>());
+        }
+        if (service.contains("bodyTimeout") && service["bodyTimeout"].is_number_integer()) {
+            serverConfig.setBodyTimeout(service["bodyTimeout"].get<int>());
+        }
+        if (service.contains("idleTimeout") && service["idleTimeout"].is_number_integer()) {
+            serverConfig.setIdleTimeout(service["idleTimeout"].get<int>());
+        }
+        if (service.contains("drainTimeout") && service["drainTimeout"].is_number_integer()) {
+            serverConfig.setDrainTimeout(service["drainTimeout"].get<int>());
+        }
+        if (service.contains("acceptors") && service["acceptors"].is_number_integer()) {
+            serverConfig.setAcceptors(service["acceptors"].get<int>());
+        }
+        if (service.contains("dedupCacheSize") && service["dedupCacheSize"].is_number_integer()) {
+            serverConfig.setDedupCacheSize(service["dedupCacheSize"].get<int>());
+        }
+        if (service.contains("capturePath") && service["capturePath"].is_string()) {
+            serverConfig.setCapturePath(service["capturePath"].get<std::string>());
+        }
+        if (service.contains("selectWeight") && service["selectWeight"].is_number_integer()) {
+            serverConfig.setSelectWeight(service["selectWeight"].get<int>());
+        }
+        if (service.contains("maxSelectWorkers") &&
+            service["maxSelectWorkers"].is_number_integer()) {
+            serverConfig.setMaxSelectWorkers(service["maxSelectWorkers"].get<int>());
+        }
+        if (service.contains("unixPath") && service["unixPath"].is_string()) {
+            serverConfig.setUnixPath(service["unixPath"].get<std::string>());
+        }
     }
 
     /* parse database object */
@@ -117,7 +327,85 @@ void Configuration::configurationProgram(const std::string &configFilePath)
         if (database.contains("path") && database["path"].is_string()) {
             databaseConfig.setFilePath(database["path"].get<std::string>());
         }
+        if (database.contains("idempotent") && database["idempotent"].is_boolean()) {
+            databaseConfig.setIdempotent(database["idempotent"].get<bool>());
+        }
+    }
+
+    /* parse parser object */
+    if (jsonDocument.contains("parser") && jsonDocument["parser"].is_object()) {
+        const auto &parser = jsonDocument["parser"];
+        if (parser.contains("compact") && parser["compact"].is_boolean()) {
+            parserConfig.setCompact(parser["compact"].get<bool>());
+        }
+        if (parser.contains("noNet") && parser["noNet"].is_boolean()) {
+            parserConfig.setNoNet(parser["noNet"].get<bool>());
+        }
+        if (parser.contains("noBlanks") && parser["noBlanks"].is_boolean()) {
+            parserConfig.setNoBlanks(parser["noBlanks"].get<bool>());
+        }
+        if (parser.contains("huge") && parser["huge"].is_boolean()) {
+            parserConfig.setHuge(parser["huge"].get<bool>());
+        }
+        if (parser.contains("maxInflatedSize") && parser["maxInflatedSize"].is_number_integer()) {
+            parserConfig.setMaxInflatedSize(parser["maxInflatedSize"].get<long long>());
+        }
+    }
+    parserConfig.validate();
+
+    /* parse performance object */
+    if (jsonDocument.contains("performance") && jsonDocument["performance"].is_object()) {
+        const auto &performance = jsonDocument["performance"];
+        if (hasPerformanceString(performance, "journalMode")) {
+            performanceConfig.setJournalMode(performance["journalMode"].get<std::string>());
+        }
+        if (hasPerformanceString(performance, "synchronous")) {
+            performanceConfig.setSynchronous(performance["synchronous"].get<std::string>());
+        }
+        if (hasPerformanceInteger(performance, "cacheSize")) {
+            performanceConfig.setCacheSize(performance["cacheSize"].get<int>());
+        }
+        if (hasPerformanceInteger(performance, "mmapSize")) {
+            performanceConfig.setMmapSize(performance["mmapSize"].get<long long>());
+        }
+        if (hasPerformanceString(performance, "tempStore")) {
+            performanceConfig.setTempStore(performance["tempStore"].get<std::string>());
+        }
+        if (hasPerformanceInteger(performance, "busyTimeout")) {
+            performanceConfig.setBusyTimeout(performance["busyTimeout"].get<int>());
+        }
+        if (hasPerformanceInteger(performance, "workers")) {
+            performanceConfig.setWorkers(performance["workers"].get<int>());
+        }
+        if (hasPerformanceInteger(performance, "loaderBatchSize")) {
+            performanceConfig.setLoaderBatchSize(performance["loaderBatchSize"].get<int>());
+        }
+        if (hasPerformanceInteger(performance, "loaderQueueSize")) {
+            performanceConfig.setLoaderQueueSize(performance["loaderQueueSize"].get<int>());
+        }
+        if (hasPerformanceInteger(performance, "planCacheSize")) {
+            performanceConfig.setPlanCacheSize(performance["planCacheSize"].get<int>());
+        }
+        if (hasPerformanceInteger(performance, "statementCacheSize")) {
+            performanceConfig.setStatementCacheSize(performance["statementCacheSize"].get<int>());
+        }
     }
+    performanceConfig.validate();
+
+    /* parse trace object */
+    if (jsonDocument.contains("trace") && jsonDocument["trace"].is_object()) {
+        const auto &trace = jsonDocument["trace"];
+        if (trace.contains("sampleRate") && trace["sampleRate"].is_number_integer()) {
+            traceConfig.setSampleRate(trace["sampleRate"].get<int>());
+        }
+        if (trace.contains("bufferSize") && trace["bufferSize"].is_number_integer()) {
+            traceConfig.setBufferSize(trace["bufferSize"].get<int>());
+        }
+        if (trace.contains("path") && trace["path"].is_string()) {
+            traceConfig.setPath(trace["path"].get<std::string>());
+        }
+    }
+    traceConfig.validate();
 
     std::cout << "Program configuraiton was seccussful.\n";
 }
@@ -128,6 +416,8 @@ void Configuration::printHelp()
     std::cout << "Usage:\n"
                  "  ./dbm -f <config file path>             : Use the "
                  "specified configuration file. by default -> ../src/config.json\n"
+                 "  ./dbm -f <config file path> -i <path>   : Load a xml file or "
+                 "all .xml files of a directory into the database without the socket.\n"
                  "  ./dbm -h                                : Display this "
                  "help message.\n"
                  "  ./dbm -v                                : Display the "
@@ -137,6 +427,8 @@ void Configuration::printHelp()
                  "\n\nAfter running the program , to connect to the socket : \n\n"
                  "telnet <ip><port> -> by defualt : telnet localhost 8080\n\n\n"
                  "To insert into the database : Enter XML data \n\n"
+                 "To send compressed XML data : add 'g' (gzip) or 'd' (deflate) after the\n"
+                 "15 digits of data length , the length is the compressed size.\n\n"
                  "To Select(view) the data in the database in XML format :\n\n"
                  "<request>\n"
                  "<operation type=\"select\"/>\n"
@@ -146,6 +438,25 @@ void Configuration::printHelp()
                  "<operation type=\"select\">\n"
                  "<table>name</table>\n"
                  "</operation>\n"
+                 "</request>\n\n"
+                 "To Select in JSON or binary format add format=\"json\" or format=\"binary\"\n"
+                 "to <operation> (binary : length-prefixed rows , see serializer.hpp).\n\n"
+                 "To Select only the rows inserted since the last poll (rowid watermarks) :\n\n"
+                 "<request>\n"
+                 "<operation type=\"changes\">\n"
+                 "<table after=\"rowid\">name</table>\n"
+                 "</operation>\n"
+                 "</request>\n\n"
+                 "Without <table> all tables are returned. The table _watermarks of the result\n"
+                 "has the rowid of every table for the after attribute of the next poll.\n\n"
+                 "To view the counters of the server :\n\n"
+                 "<request>\n"
+                 "<operation type=\"stats\"/>\n"
+                 "</request>\n\n"
+                 "To get the spans of sampled requests as chrome trace json\n"
+                 "(also written to trace.path on SIGUSR1) :\n\n"
+                 "<request>\n"
+                 "<operation type=\"trace\"/>\n"
                  "</request>\n\n";
 }
 
@@ -180,6 +491,22 @@ ServerConfiguration &Configuration::getServerConfig()
 {
     return serverConfig;
 }
+ParserConfiguration &Configuration::getParserConfig()
+{
+    return parserConfig;
+}
+PerformanceConfiguration &Configuration::getPerformanceConfig()
+{
+    return performanceConfig;
+}
+TraceConfiguration &Configuration::getTraceConfig()
+{
+    return traceConfig;
+}
+const std::string &Configuration::getImportPath() const
+{
+    return importPath;
+}
 
 /**
  *
@@ -217,6 +544,129 @@ void ServerConfiguration::setMaxConnection(int maxConnection)
     this->maxConnection = maxConnection;
 }
 
+size_t ServerConfiguration::getWriteHighWatermark() const
+{
+    return writeHighWatermark;
+}
+int ServerConfiguration::getWriteTimeout() const
+{
+    return writeTimeout;
+}
+void ServerConfiguration::setWriteHighWatermark(size_t writeHighWatermark)
+{
+    this->writeHighWatermark = writeHighWatermark;
+}
+void ServerConfiguration::setWriteTimeout(int writeTimeout)
+{
+    this->writeTimeout = writeTimeout;
+}
+
+int ServerConfiguration::getMaxClients() const
+{
+    return maxClients;
+}
+int ServerConfiguration::getMaxInFlight() const
+{
+    return maxInFlight;
+}
+int ServerConfiguration::getAdmissionWait() const
+{
+    return admissionWait;
+}
+void ServerConfiguration::setMaxClients(int maxClients)
+{
+    this->maxClients = maxClients;
+}
+void ServerConfiguration::setMaxInFlight(int maxInFlight)
+{
+    this->maxInFlight = maxInFlight;
+}
+void ServerConfiguration::setAdmissionWait(int admissionWait)
+{
+    this->admissionWait = admissionWait;
+}
+
+int ServerConfiguration::getHeaderTimeout() const
+{
+    return headerTimeout;
+}
+int ServerConfiguration::getBodyTimeout() const
+{
+    return bodyTimeout;
+}
+int ServerConfiguration::getIdleTimeout() const
+{
+    return idleTimeout;
+}
+void ServerConfiguration::setHeaderTimeout(int headerTimeout)
+{
+    this->headerTimeout = headerTimeout;
+}
+void ServerConfiguration::setBodyTimeout(int bodyTimeout)
+{
+    this->bodyTimeout = bodyTimeout;
+}
+void ServerConfiguration::setIdleTimeout(int idleTimeout)
+{
+    this->idleTimeout = idleTimeout;
+}
+int ServerConfiguration::getDrainTimeout() const
+{
+    return drainTimeout;
+}
+void ServerConfiguration::setDrainTimeout(int drainTimeout)
+{
+    this->drainTimeout = drainTimeout;
+}
+int ServerConfiguration::getAcceptors() const
+{
+    return acceptors;
+}
+void ServerConfiguration::setAcceptors(int acceptors)
+{
+    this->acceptors = acceptors;
+}
+const std::string &ServerConfiguration::getUnixPath() const
+{
+    return unixPath;
+}
+void ServerConfiguration::setUnixPath(const std::string &unixPath)
+{
+    this->unixPath = unixPath;
+}
+int ServerConfiguration::getDedupCacheSize() const
+{
+    return dedupCacheSize;
+}
+void ServerConfiguration::setDedupCacheSize(int dedupCacheSize)
+{
+    this->dedupCacheSize = dedupCacheSize;
+}
+const std::string &ServerConfiguration::getCapturePath() const
+{
+    return capturePath;
+}
+void ServerConfiguration::setCapturePath(const std::string &capturePath)
+{
+    this->capturePath = capturePath;
+}
+int ServerConfiguration::getSelectWeight() const
+{
+    return selectWeight;
+}
+void ServerConfiguration::setSelectWeight(int selectWeight)
+{
+    this->selectWeight = selectWeight;
+}
+int ServerConfiguration::getMaxSelectWorkers() const
+{
+    return maxSelectWorkers;
+}
+void ServerConfiguration::setMaxSelectWorkers(int maxSelectWorkers)
+{
+    this->maxSelectWorkers = maxSelectWorkers;
+}
+
 /**
  *
  *
@@ -229,8 +679,257 @@ std::string DatabaseConfiguration::getFilePath() const
 {
     return filePath;
 }
+bool DatabaseConfiguration::getIdempotent() const
+{
+    return idempotent;
+}
 void DatabaseConfiguration::setFilePath(const std::string &filePath)
 {
     this->filePath = filePath;
 }
+void DatabaseConfiguration::setIdempotent(bool idempotent)
+{
+    this->idempotent = idempotent;
+}
+
+/* Converts value to upper case and checks that it is one of the allowed values */
+static void validateChoice(std::string &value, const std::vector<std::string> &allowed,
+                           const std::string &name)
+{
+    std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+
+    if (std::find(allowed.begin(), allowed.end(), value) == allowed.end())
+        throw std::runtime_error("Invalid performance." + name + ": " + value + "\n");
+}
+
+/* Checks that a number is in [min , max]*/
+static void validateRange(long long value, long long min, long long max, const std::string &name,
+                          const std::string &section = "performance")
+{
+    if (value < min || value > max)
+        throw std::runtime_error("Invalid " + section + "." + name + ": " + std::to_string(value) +
+                                 " (allowed " + std::to_string(min) + " to " +
+                                 std::to_string(max) + ")\n");
+}
+
+/**
+ *
+ *
+ * Implementation for "ParserConfiguration" class
+ *
+ *
+ */
+
+bool ParserConfiguration::getCompact() const
+{
+    return compact;
+}
+bool ParserConfiguration::getNoNet() const
+{
+    return noNet;
+}
+bool ParserConfiguration::getNoBlanks() const
+{
+    return noBlanks;
+}
+bool ParserConfiguration::getHuge() const
+{
+    return huge;
+}
+long long ParserConfiguration::getMaxInflatedSize() const
+{
+    return maxInflatedSize;
+}
+void ParserConfiguration::setCompact(bool compact)
+{
+    this->compact = compact;
+}
+void ParserConfiguration::setNoNet(bool noNet)
+{
+    this->noNet = noNet;
+}
+void ParserConfiguration::setNoBlanks(bool noBlanks)
+{
+    this->noBlanks = noBlanks;
+}
+void ParserConfiguration::setHuge(bool huge)
+{
+    this->huge = huge;
+}
+void ParserConfiguration::setMaxInflatedSize(long long maxInflatedSize)
+{
+    this->maxInflatedSize = maxInflatedSize;
+}
+
+void ParserConfiguration::validate()
+{
+    validateRange(maxInflatedSize, 1024, 1LL << 40, "maxInflatedSize", "parser");
+}
+
+/**
+ *
+ *
+ * Implementation for "PerformanceConfiguration" class
+ *
+ *
+ */
+
+/*
+ * Validates the performance section before anything uses it , so a typo stops the
+ * program at startup instead of running with SQLite defaults.
+ */
+void PerformanceConfiguration::validate()
+{
+    validateChoice(journalMode, {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"},
+                   "journalMode");
+    validateChoice(synchronous, {"OFF", "NORMAL", "FULL", "EXTRA"}, "synchronous");
+    validateChoice(tempStore, {"DEFAULT", "FILE", "MEMORY"}, "tempStore");
+
+    validateRange(cacheSize, 0, 16 * 1024 * 1024, "cacheSize");
+    validateRange(mmapSize, 0, 1LL << 40, "mmapSize");
+    validateRange(busyTimeout, 0, 600000, "busyTimeout");
+    validateRange(workers, 0, 1024, "workers");
+    validateRange(loaderBatchSize, 1, 1000000, "loaderBatchSize");
+    validateRange(loaderQueueSize, loaderBatchSize, 100000000, "loaderQueueSize");
+    validateRange(planCacheSize, 0, 1000000, "planCacheSize");
+    validateRange(statementCacheSize, 0, 100000, "statementCacheSize");
+}
+
+size_t PerformanceConfiguration::getWorkerCount() const
+{
+    if (workers > 0)
+        return workers;
+
+    return std::max(1u, std::thread::hardware_concurrency());
+}
 
+const std::string &PerformanceConfiguration::getJournalMode() const
+{
+    return journalMode;
+}
+const std::string &PerformanceConfiguration::getSynchronous() const
+{
+    return synchronous;
+}
+int PerformanceConfiguration::getCacheSize() const
+{
+    return cacheSize;
+}
+long long PerformanceConfiguration::getMmapSize() const
+{
+    return mmapSize;
+}
+const std::string &PerformanceConfiguration::getTempStore() const
+{
+    return tempStore;
+}
+int PerformanceConfiguration::getBusyTimeout() const
+{
+    return busyTimeout;
+}
+int PerformanceConfiguration::getWorkers() const
+{
+    return workers;
+}
+int PerformanceConfiguration::getLoaderBatchSize() const
+{
+    return loaderBatchSize;
+}
+int PerformanceConfiguration::getLoaderQueueSize() const
+{
+    return loaderQueueSize;
+}
+int PerformanceConfiguration::getPlanCacheSize() const
+{
+    return planCacheSize;
+}
+int PerformanceConfiguration::getStatementCacheSize() const
+{
+    return statementCacheSize;
+}
+void PerformanceConfiguration::setJournalMode(const std::string &journalMode)
+{
+    this->journalMode = journalMode;
+}
+void PerformanceConfiguration::setSynchronous(const std::string &synchronous)
+{
+    this->synchronous = synchronous;
+}
+void PerformanceConfiguration::setCacheSize(int cacheSize)
+{
+    this->cacheSize = cacheSize;
+}
+void PerformanceConfiguration::setMmapSize(long long mmapSize)
+{
+    this->mmapSize = mmapSize;
+}
+void PerformanceConfiguration::setTempStore(const std::string &tempStore)
+{
+    this->tempStore = tempStore;
+}
+void PerformanceConfiguration::setBusyTimeout(int busyTimeout)
+{
+    this->busyTimeout = busyTimeout;
+}
+void PerformanceConfiguration::setWorkers(int workers)
+{
+    this->workers = workers;
+}
+void PerformanceConfiguration::setLoaderBatchSize(int loaderBatchSize)
+{
+    this->loaderBatchSize = loaderBatchSize;
+}
+void PerformanceConfiguration::setLoaderQueueSize(int loaderQueueSize)
+{
+    this->loaderQueueSize = loaderQueueSize;
+}
+void PerformanceConfiguration::setPlanCacheSize(int planCacheSize)
+{
+    this->planCacheSize = planCacheSize;
+}
+void PerformanceConfiguration::setStatementCacheSize(int statementCacheSize)
+{
+    this->statementCacheSize = statementCacheSize;
+}
+
+/**
+ *
+ *
+ * Implementation for "TraceConfiguration" class
+ *
+ *
+ */
+
+void TraceConfiguration::validate()
+{
+    validateRange(sampleRate, 0, 1000000, "sampleRate", "trace");
+    validateRange(bufferSize, 16, 16 * 1024 * 1024, "bufferSize", "trace");
+
+    if (path.empty())
+        throw std::runtime_error("Invalid trace.path: empty\n");
+}
+
+int TraceConfiguration::getSampleRate() const
+{
+    return sampleRate;
+}
+int TraceConfiguration::getBufferSize() const
+{
+    return bufferSize;
+}
+const std::string &TraceConfiguration::getPath() const
+{
+    return path;
+}
+void TraceConfiguration::setSampleRate(int sampleRate)
+{
+    this->sampleRate = sampleRate;
+}
+void TraceConfiguration::setBufferSize(int bufferSize)
+{
+    this->bufferSize = bufferSize;
+}
+void TraceConfiguration::setPath(const std::string &path)
+{
+    this->path = path;
+}
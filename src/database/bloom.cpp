@@ -0,0 +1,98 @@
+#include "bloom.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/*About 1% false positives : 9.6 bits and 7 hashes for each key*/
+const double bloomBitsPerKey = 9.6;
+const unsigned bloomHashCount = 7;
+
+namespace SQLite
+{
+
+/**
+ *
+ * Implementation for "BloomFilter" class
+ *
+ */
+
+BloomFilter::BloomFilter() : bitCount {0}, hashCount {bloomHashCount}, count {0}, capacity {0}
+{
+}
+
+void BloomFilter::reset(size_t capacity)
+{
+    this->capacity = std::max<size_t>(capacity, 1);
+    count = 0;
+
+    bitCount = static_cast<size_t>(std::ceil(this->capacity * bloomBitsPerKey));
+    bitCount = (bitCount + 63) / 64 * 64;
+
+    bits.assign(bitCount / 64, 0);
+}
+
+void BloomFilter::add(const std::string &key)
+{
+    if (bitCount == 0)
+        return;
+
+    uint64_t h1, h2;
+    hash(key, h1, h2);
+
+    for (unsigned i = 0; i < hashCount; i++) {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+    count++;
+}
+
+bool BloomFilter::mayContain(const std::string &key) const
+{
+    if (bitCount == 0)
+        return false;
+
+    uint64_t h1, h2;
+    hash(key, h1, h2);
+
+    for (unsigned i = 0; i < hashCount; i++) {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        if ((bits[bit / 64] & (1ULL << (bit % 64))) == 0)
+            return false;
+    }
+    return true;
+}
+
+bool BloomFilter::isFull() const
+{
+    return count > capacity;
+}
+
+size_t BloomFilter::getCount() const
+{
+    return count;
+}
+
+size_t BloomFilter::getCapacity() const
+{
+    return capacity;
+}
+
+/*
+ * h1 is the FNV-1a hash of key , h2 is h1 mixed again (splitmix64 finalizer) and
+ * made odd , so the bits of a key are spread over the whole filter.
+ */
+void BloomFilter::hash(const std::string &key, uint64_t &h1, uint64_t &h2)
+{
+    h1 = 14695981039346656037ULL;
+    for (char c : key) {
+        h1 ^= static_cast<unsigned char>(c);
+        h1 *= 1099511628211ULL;
+    }
+
+    h2 = h1 + 0x9E3779B97F4A7C15ULL;
+    h2 = (h2 ^ (h2 >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h2 = (h2 ^ (h2 >> 27)) * 0x94D049BB133111EBULL;
+    h2 = (h2 ^ (h2 >> 31)) | 1;
+}
+
+} /* namespace SQLite */
@@ -1,17 +1,45 @@
 #include "database.hpp"
 
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
 namespace SQLite
 {
+
+/*Select results are passed to the sink in chunks of about this size (bytes)*/
+const size_t selectChunkSize = 64 * 1024;
+
+/*The uuid filter has room for at least this many uuids*/
+const size_t uuidFilterMinCapacity = 1 << 16;
 /**
  *
  * Implementation for "Database" class
  *
  */
 
-DatabaseManager::DatabaseManager(const DatabaseConfiguration &databaseConfiguration) :
-    fileName {databaseConfiguration.getFilePath()}
+DatabaseManager::DatabaseManager(const DatabaseConfiguration &databaseConfiguration,
+                                 const PerformanceConfiguration &performanceConfiguration) :
+    fileName {databaseConfiguration.getFilePath()},
+    statementCacheSize {0},
+    idempotent {databaseConfiguration.getIdempotent()}
 {
     openDatabase();
+
+    try {
+        applyPragmas(performanceConfiguration);
+
+        if (idempotent) {
+            buildUuidFilterLocked(0);
+            std::cout << "Uuid filter : " << uuidFilter.getCount() << " stored uuids.\n";
+        }
+    } catch (...) {
+        /*The destructor is not called when the constructor throws*/
+        closeDatabase();
+        throw;
+    }
 }
 
 DatabaseManager::~DatabaseManager()
@@ -33,15 +61,97 @@ void DatabaseManager::openDatabase()
 void DatabaseManager::closeDatabase()
 {
     if (database) {
+        /*sqlite3_close fails while statements are not finalized*/
+        clearStatementsLocked();
         sqlite3_close(database);
     }
 }
 
+/*
+ * Applies the validated pragmas of the performance section.
+ * journal_mode answers with the mode in use , a database that cannot change
+ * its mode (for example WAL on an in-memory database) is reported.
+ */
+void DatabaseManager::applyPragmas(const PerformanceConfiguration &performanceConfiguration)
+{
+    std::string journalMode = performanceConfiguration.getJournalMode();
+
+    sqlite3_stmt *stmt;
+    std::string query = "PRAGMA journal_mode=" + journalMode + ";";
+    if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+        throw DatabaseException(std::string("Can't set journal mode: ") +
+                                sqlite3_errmsg(database) + "\n");
+
+    std::string appliedMode;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        appliedMode = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    sqlite3_finalize(stmt);
+
+    std::transform(appliedMode.begin(), appliedMode.end(), appliedMode.begin(), ::toupper);
+    if (appliedMode != journalMode)
+        std::cerr << "Warning : journal mode is " << appliedMode << " instead of " << journalMode
+                  << "\n";
+
+    tuneLocked(performanceConfiguration);
+}
+
+/* Applies the pragmas that can change at runtime (configuration reload).*/
+void DatabaseManager::tune(const PerformanceConfiguration &performanceConfiguration)
+{
+    std::lock_guard<InstrumentedMutex> lock(dbMutex);
+    tuneLocked(performanceConfiguration);
+}
+
+std::unique_lock<InstrumentedMutex> DatabaseManager::lockDatabase()
+{
+    TraceSpan span {"db.wait"};
+    return std::unique_lock<InstrumentedMutex>(dbMutex);
+}
+
+/* cache_size is given in KiB , a negative cache_size means KiB for SQLite.*/
+void DatabaseManager::tuneLocked(const PerformanceConfiguration &performanceConfiguration)
+{
+    statementCacheSize = performanceConfiguration.getStatementCacheSize();
+    if (statements.size() > statementCacheSize)
+        clearStatementsLocked();
+
+    if (sqlite3_busy_timeout(database, performanceConfiguration.getBusyTimeout()) != SQLITE_OK)
+        throw DatabaseException("Can't set busy timeout\n");
+
+    execute("PRAGMA synchronous=" + performanceConfiguration.getSynchronous() + ";",
+            "Can't set synchronous: ");
+    execute("PRAGMA cache_size=" + std::to_string(-performanceConfiguration.getCacheSize()) +
+                ";",
+            "Can't set cache size: ");
+    execute("PRAGMA mmap_size=" + std::to_string(performanceConfiguration.getMmapSize()) + ";",
+            "Can't set mmap size: ");
+    execute("PRAGMA temp_store=" + performanceConfiguration.getTempStore() + ";",
+            "Can't set temp store: ");
+}
+
+/* Executes a query that returns no rows.*/
+void DatabaseManager::execute(const std::string &query, const std::string &errorMessage)
+{
+    char *errMsg = nullptr;
+
+    if (sqlite3_exec(database, query.c_str(), 0, 0, &errMsg) != SQLITE_OK) {
+        if (errMsg)
+            sqlite3_free(errMsg);
+        std::string message = errorMessage + sqlite3_errmsg(database);
+        throw DatabaseException(message);
+    }
+}
+
 /* Checks if a table with the given name exists	in the database.*/
 bool DatabaseManager::isExistTable(const std::string &name)
 {
     /*Thread safety*/
-    std::lock_guard<std::mutex> lock(dbMutex);
+    std::lock_guard<InstrumentedMutex> lock(dbMutex);
+    return isExistTableLocked(name);
+}
+
+bool DatabaseManager::isExistTableLocked(const std::string &name)
+{
     std::string query = queryIsExistTable(name);
 
     bool exist = false;
@@ -81,18 +191,18 @@ void DatabaseManager::createTable(const std::string &name,
                                   const std::string &mainTable)
 {
     /*Thread safety*/
-    std::lock_guard<std::mutex> lock(dbMutex);
-    std::string query = queryCreate(name, properties, isMainTable, mainTable);
+    std::lock_guard<InstrumentedMutex> lock(dbMutex);
+    createTableLocked(name, properties, isMainTable, mainTable);
+}
 
-    char *errMsg = nullptr;
+void DatabaseManager::createTableLocked(const std::string &name,
+                                        const std::vector<std::string> &properties,
+                                        bool isMainTable, const std::string &mainTable)
+{
+    std::string query = queryCreate(name, properties, isMainTable, mainTable);
 
     /*Executes the CREATE TABLE statement*/
-    if (sqlite3_exec(database, query.c_str(), 0, 0, &errMsg) != SQLITE_OK) {
-        if (errMsg)
-            sqlite3_free(errMsg);
-        std::string message = std::string("Error creating table \n") + sqlite3_errmsg(database);
-        throw DatabaseException(message);
-    }
+    execute(query, "Error creating table \n");
 }
 
 /* Creates a SQL query string to create a new table.*/
@@ -139,19 +249,20 @@ void DatabaseManager::insertIntoTable(const std::string &uuid,
                                       const std::string &tableName)
 {
     /*Thread safety*/
-    std::lock_guard<std::mutex> lock(dbMutex);
+    std::lock_guard<InstrumentedMutex> lock(dbMutex);
+    insertIntoTableLocked(uuid, names, values, tableName);
+}
 
+void DatabaseManager::insertIntoTableLocked(const std::string &uuid,
+                                            const std::vector<std::string> &names,
+                                            const std::vector<std::string> &values,
+                                            const std::string &tableName)
+{
     std::string query = queryInsert(names, tableName);
 
-    sqlite3_stmt *stmt;
+    /*Takes the prepared parameterized INSERT statement from the cache*/
+    sqlite3_stmt *stmt = prepareCachedLocked(query);
 
-    /*Prepares parameterized INSERT statement*/
-    if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        std::string message = std::string("Error in insert in to table \n") +
-                              sqlite3_errmsg(database);
-
-        throw DatabaseException(message);
-    }
     /*Binds parameters safely*/
     sqlite3_bind_text(stmt, 1, uuid.c_str(), -1, SQLITE_STATIC);
 
@@ -162,10 +273,325 @@ void DatabaseManager::insertIntoTable(const std::string &uuid,
     /*Executes statement*/
     if (sqlite3_step(stmt) != SQLITE_DONE) {
         std::string message = std::string("Error executing insert \n") + sqlite3_errmsg(database);
+        releaseStatementLocked(stmt);
 
         throw DatabaseException(message);
     }
+    releaseStatementLocked(stmt);
+}
+
+/*
+ * Returns the cached statement of query or prepares it.
+ * A full cache is emptied before a new statement is added , the statements of
+ * repeated document shapes are prepared again at once.
+ */
+sqlite3_stmt *DatabaseManager::prepareCachedLocked(const std::string &query)
+{
+    auto it = statements.find(query);
+    if (it != statements.end())
+        return it->second;
+
+    sqlite3_stmt *stmt;
+
+    /*Prepares parameterized statement*/
+    if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        std::string message = std::string("Error in insert in to table \n") +
+                              sqlite3_errmsg(database);
+
+        throw DatabaseException(message);
+    }
+
+    if (statementCacheSize == 0)
+        return stmt;
+
+    if (statements.size() >= statementCacheSize)
+        clearStatementsLocked();
+
+    statements.emplace(query, stmt);
+    return stmt;
+}
+
+/* Resets a cached statement , finalizes it if the cache is disabled.*/
+void DatabaseManager::releaseStatementLocked(sqlite3_stmt *stmt)
+{
+    if (statementCacheSize == 0) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+/* Finalizes all cached statements.*/
+void DatabaseManager::clearStatementsLocked()
+{
+    for (auto &statement : statements)
+        sqlite3_finalize(statement.second);
+
+    statements.clear();
+}
+
+/* The key of a uuid in the filter , a table name never contains '\n'.*/
+static std::string uuidKey(const std::string &mainTable, const std::string &uuid)
+{
+    return mainTable + '\n' + uuid;
+}
+
+/*
+ * Builds the uuid filter from the stored uuids.
+ * The filter is sized for twice the stored uuids , so it is not full at once.
+ */
+void DatabaseManager::buildUuidFilterLocked(size_t minimum)
+{
+    uuidKeyTables.clear();
+
+    std::vector<std::string> tables;
+    size_t stored = 0;
+
+    for (const std::string &table : getAllTableNames()) {
+        if (! isUuidKeyTableLocked(table))
+            continue;
+
+        tables.push_back(table);
+
+        sqlite3_stmt *stmt;
+        std::string query = "SELECT count(*) FROM " + table + ";";
+        if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+            throw DatabaseException(std::string("Error counting uuids \n") +
+                                    sqlite3_errmsg(database));
+
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            stored += sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+
+    uuidFilter.reset(std::max({minimum, 2 * stored, uuidFilterMinCapacity}));
+
+    for (const std::string &table : tables) {
+        sqlite3_stmt *stmt;
+        std::string query = "SELECT uuid FROM " + table + ";";
+        if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+            throw DatabaseException(std::string("Error reading uuids \n") +
+                                    sqlite3_errmsg(database));
+
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *uuid = (const char *) sqlite3_column_text(stmt, 0);
+            if (uuid)
+                uuidFilter.add(uuidKey(table, uuid));
+        }
+        sqlite3_finalize(stmt);
+    }
+}
+
+/* A main table is created with "uuid TEXT PRIMARY KEY" (pk column of table_info).*/
+bool DatabaseManager::isUuidKeyTableLocked(const std::string &table)
+{
+    auto it = uuidKeyTables.find(table);
+    if (it != uuidKeyTables.end())
+        return it->second;
+
+    sqlite3_stmt *stmt;
+    std::string query = "PRAGMA table_info(" + table + ");";
+    if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+        throw DatabaseException(std::string("Error reading table info \n") +
+                                sqlite3_errmsg(database));
+
+    bool exists = false;
+    bool uuidKey = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        exists = true;
+
+        const char *column = (const char *) sqlite3_column_text(stmt, 1);
+        if (column && strcmp(column, "uuid") == 0 && sqlite3_column_int(stmt, 5) > 0)
+            uuidKey = true;
+    }
     sqlite3_finalize(stmt);
+
+    /*A table that does not exist yet may be created later*/
+    if (exists)
+        uuidKeyTables[table] = uuidKey;
+
+    return uuidKey;
+}
+
+/*
+ * Checks whether uuid is stored.
+ * Most new uuids are rejected by the filter without reading the database , a
+ * match is confirmed with the primary key index (the filter has false positives).
+ */
+bool DatabaseManager::isStoredLocked(const std::string &mainTable, const std::string &uuid)
+{
+    if (! idempotent || ! uuidFilter.mayContain(uuidKey(mainTable, uuid)))
+        return false;
+
+    if (! isUuidKeyTableLocked(mainTable))
+        return false;
+
+    sqlite3_stmt *stmt = prepareCachedLocked("SELECT 1 FROM " + mainTable +
+                                             " WHERE uuid = ? LIMIT 1;");
+    sqlite3_bind_text(stmt, 1, uuid.c_str(), -1, SQLITE_STATIC);
+
+    bool stored = (sqlite3_step(stmt) == SQLITE_ROW);
+    releaseStatementLocked(stmt);
+
+    if (! stored)
+        Metrics::instance().counter("uuidFilter.falsePositives").add();
+
+    return stored;
+}
+
+/* Adds a stored uuid , a full filter is built again from the database.*/
+void DatabaseManager::rememberUuidLocked(const std::string &mainTable, const std::string &uuid)
+{
+    if (! idempotent || ! isUuidKeyTableLocked(mainTable))
+        return;
+
+    uuidFilter.add(uuidKey(mainTable, uuid));
+
+    if (uuidFilter.isFull()) {
+        buildUuidFilterLocked(2 * uuidFilter.getCapacity());
+        Metrics::instance().counter("uuidFilter.rebuilds").add();
+    }
+}
+
+/*
+ * Inserts all rows of one xml data in a single transaction.
+ *
+ * If anything fails the transaction is rolled back so no partial
+ * xml data stays in the database.
+ */
+bool DatabaseManager::insertRows(const std::string &uuid, const std::string &mainTable,
+                                 const std::vector<TableRow> &rows)
+{
+    /*Thread safety*/
+    std::unique_lock<InstrumentedMutex> lock = lockDatabase();
+    TraceSpan span {"db.insert"};
+
+    /*A retried xml data is acknowledged before any write*/
+    if (isStoredLocked(mainTable, uuid))
+        return false;
+
+    execute("BEGIN;", "Error beginning transaction \n");
+
+    try {
+        std::unordered_set<std::string> knownTables;
+        insertRowsLocked(uuid, mainTable, rows, knownTables);
+
+        execute("COMMIT;", "Error committing transaction \n");
+
+    } catch (const DatabaseException &de) {
+        sqlite3_exec(database, "ROLLBACK;", 0, 0, nullptr);
+        clearStatementsLocked();
+        uuidKeyTables.clear();
+        throw;
+    }
+
+    rememberUuidLocked(mainTable, uuid);
+    return true;
+}
+
+/*
+ * Inserts a batch of xml data in a single transaction.
+ *
+ * Every xml data is wrapped in a savepoint , a failed xml data is rolled
+ * back to its savepoint and reported in errors , the others are committed.
+ */
+size_t DatabaseManager::insertDocuments(const std::vector<DocumentRows> &documents,
+                                        std::vector<std::pair<size_t, std::string>> &errors,
+                                        size_t &duplicates)
+{
+    /*Thread safety*/
+    std::lock_guard<InstrumentedMutex> lock(dbMutex);
+
+    size_t stored = 0;
+
+    execute("BEGIN;", "Error beginning transaction \n");
+
+    try {
+        std::unordered_set<std::string> knownTables;
+
+        for (size_t i = 0; i < documents.size(); i++) {
+            const DocumentRows &document = documents[i];
+
+            /*Also finds a duplicate inserted earlier in this batch*/
+            if (isStoredLocked(document.mainTable, document.uuid)) {
+                duplicates++;
+                continue;
+            }
+
+            bool inserted = true;
+
+            execute("SAVEPOINT document;", "Error creating savepoint \n");
+            try {
+                insertRowsLocked(document.uuid, document.mainTable, document.rows, knownTables);
+                stored++;
+
+            } catch (const DatabaseException &de) {
+                execute("ROLLBACK TO document;", "Error rolling back savepoint \n");
+
+                /*Tables created by the rolled back xml data do not exist anymore*/
+                knownTables.clear();
+                clearStatementsLocked();
+
+                errors.emplace_back(i, document.uuid + " : " + de.what());
+                inserted = false;
+            }
+            execute("RELEASE document;", "Error releasing savepoint \n");
+
+            if (inserted)
+                rememberUuidLocked(document.mainTable, document.uuid);
+        }
+
+        execute("COMMIT;", "Error committing transaction \n");
+
+    } catch (const DatabaseException &de) {
+        sqlite3_exec(database, "ROLLBACK;", 0, 0, nullptr);
+        clearStatementsLocked();
+
+        /*Tables created by the batch do not exist anymore , the filter only has false positives*/
+        uuidKeyTables.clear();
+        throw;
+    }
+
+    return stored;
+}
+
+/*
+ * Checkpoints the write-ahead log before shut down , so the database file is
+ * complete without the -wal file.
+ */
+void DatabaseManager::checkpoint()
+{
+    std::lock_guard<InstrumentedMutex> lock(dbMutex);
+
+    int logFrames = 0;
+    int checkpointedFrames = 0;
+    int result = sqlite3_wal_checkpoint_v2(database, nullptr, SQLITE_CHECKPOINT_TRUNCATE,
+                                           &logFrames, &checkpointedFrames);
+    if (result != SQLITE_OK)
+        throw DatabaseException(std::string("Checkpoint failed: ") + sqlite3_errmsg(database) +
+                                "\n");
+}
+
+/*
+ * Inserts the rows of one xml data in the given order , the first row of a table
+ * that does not exist creates it (main table with uuid primary key).
+ */
+void DatabaseManager::insertRowsLocked(const std::string &uuid, const std::string &mainTable,
+                                       const std::vector<TableRow> &rows,
+                                       std::unordered_set<std::string> &knownTables)
+{
+    for (const TableRow &row : rows) {
+        if (knownTables.count(row.tableName) == 0) {
+            if (! isExistTableLocked(row.tableName)) {
+                bool isMainTable = (mainTable == row.tableName);
+                createTableLocked(row.tableName, row.names, isMainTable, mainTable);
+            }
+            knownTables.insert(row.tableName);
+        }
+        insertIntoTableLocked(uuid, row.names, row.values, row.tableName);
+    }
 }
 
 /* Creates a SQL query string to insert values into the specified table.*/
@@ -223,70 +649,249 @@ std::string DatabaseManager::queryAllTableNames()
     return query;
 }
 
-/* Fetches data from the specified table and returns it as an XML string.*/
-std::string DatabaseManager::fetchTableDataAsXML(const std::string &tableName)
+/*
+ * Fetches data from the specified table and passes it to sink in the given format.
+ *
+ * The result is passed in chunks of about selectChunkSize bytes , so a big table is
+ * never stored as one string. Chunks are queued without waiting for the client , when
+ * the client falls behind dbMutex is released until it catches up , so a slow client
+ * never holds the database. Rows inserted meanwhile may be part of the result.
+ */
+void DatabaseManager::fetchTableData(const std::string &tableName, OutputFormat format,
+                                     ResultSink &sink)
 {
-    std::lock_guard<std::mutex> lock(dbMutex);
-    std::ostringstream xmlStream;
+    std::unique_ptr<ResultSerializer> serializer = makeSerializer(format);
+    sendToSink(serializer->header(false), sink);
 
-    xmlStream << "<" << tableName << ">\n";
+    std::unique_lock<InstrumentedMutex> lock = lockDatabase();
+    fetchTableLocked(lock, tableName, *serializer, true, sink);
+    lock.unlock();
 
-    std::string query = querySelect(tableName);
+    sendToSink(serializer->footer(false), sink);
+}
 
-    sqlite3_stmt *stmt;
+/*
+ * Writes the rows of a table after a rowid with serializer and passes them to sink.
+ * Rows are read in rowid order : a range scan of the rowid b-tree , so the cost of a
+ * changes query depends on the new rows and not on the size of the table.
+ * When sink is full the statement is finalized and dbMutex released until sink
+ * drained , then the scan continues after the last rowid written.
+ */
+long long DatabaseManager::fetchTableLocked(std::unique_lock<InstrumentedMutex> &lock,
+                                            const std::string &tableName,
+                                            ResultSerializer &serializer, bool first,
+                                            ResultSink &sink, long long after)
+{
+    TraceSpan span {"db.select"};
+    serializer.clear();
 
-    if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        std::string message = "Error preparing select query: " +
-                              std::string(sqlite3_errmsg(database));
-        throw DatabaseException(message);
-    }
+    std::string query = querySelectAfter(tableName);
+    long long lastRowid = after;
+    bool begun = false;
 
-    int columnCount = sqlite3_column_count(stmt);
+    while (true) {
+        sqlite3_stmt *stmt;
 
-    if (columnCount < 1) {
-        sqlite3_finalize(stmt);
-        return "<" + tableName + " />\n";
-    }
+        if (sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            std::string message = "Error preparing select query: " +
+                                  std::string(sqlite3_errmsg(database));
+            throw DatabaseException(message);
+        }
+        sqlite3_bind_int64(stmt, 1, lastRowid);
 
-    /*Process each row and column*/
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        for (int i = 0; i < columnCount; ++i) {
-            const char *columnName = sqlite3_column_name(stmt, i);
-            const char *columnValue = (const char *) sqlite3_column_text(stmt, i);
+        /*Column 0 is the rowid , it is read and not written*/
+        int columnCount = sqlite3_column_count(stmt);
+
+        if (! begun) {
+            std::vector<std::string> columns;
+            for (int i = 1; i < columnCount; ++i)
+                columns.push_back(sqlite3_column_name(stmt, i));
+
+            serializer.beginTable(tableName, columns, first);
+            begun = true;
+        }
 
-            xmlStream << "    <" << columnName << ">" << (columnValue ? columnValue : "NULL")
-                      << "</" << columnName << ">\n";
+        bool full = false;
+        try {
+            /*Process each row and column*/
+            while (! full && columnCount > 1 && sqlite3_step(stmt) == SQLITE_ROW) {
+                lastRowid = sqlite3_column_int64(stmt, 0);
+
+                serializer.beginRow();
+                for (int i = 1; i < columnCount; ++i) {
+                    const char *columnValue = (const char *) sqlite3_column_text(stmt, i);
+                    serializer.appendValue(i - 1, columnValue, sqlite3_column_bytes(stmt, i));
+                }
+                serializer.endRow();
+
+                if (serializer.size() >= selectChunkSize) {
+                    flushToSink(serializer, sink);
+                    full = sink.isFull();
+                }
+            }
+        } catch (const DatabaseException &de) {
+            sqlite3_finalize(stmt);
+            throw;
         }
+
+        sqlite3_finalize(stmt);
+
+        if (! full)
+            break;
+
+        lock.unlock();
+        drainSink(sink);
+        lock.lock();
     }
 
-    sqlite3_finalize(stmt);
-    xmlStream << "</" << tableName << ">\n";
+    serializer.endTable();
+    flushToSink(serializer, sink);
+
+    return lastRowid;
+}
 
-    return xmlStream.str();
+/* Passes the buffer of serializer to sink and clears it (its capacity is kept).*/
+void DatabaseManager::flushToSink(ResultSerializer &serializer, ResultSink &sink)
+{
+    bool received = sink.write(serializer.getBuffer());
+    serializer.clear();
+
+    if (! received)
+        throw DatabaseException("Client stopped receiving data\n");
 }
 
-/* Creates a SQL query string to SELECT table*/
-std::string DatabaseManager::querySelect(const std::string &tableName)
+/* Passes data to sink (nothing if data is empty).*/
+void DatabaseManager::sendToSink(const std::string &data, ResultSink &sink)
 {
-    std::string query = "SELECT * FROM " + tableName + ";";
+    if (! data.empty() && ! sink.write(data))
+        throw DatabaseException("Client stopped receiving data\n");
+}
+
+/* The caller must not hold dbMutex , drain waits for the client.*/
+void DatabaseManager::drainSink(ResultSink &sink)
+{
+    if (sink.isFull() && ! sink.drain())
+        throw DatabaseException("Client stopped receiving data\n");
+}
+
+/*
+ * A serializer keeps the state of the table it writes , and dbMutex is released in
+ * the middle of a table , so every select has its own serializer (reused for all of
+ * its chunks).
+ */
+std::unique_ptr<ResultSerializer> DatabaseManager::makeSerializer(OutputFormat format)
+{
+    size_t capacity = selectChunkSize + selectChunkSize / 4;
+
+    switch (format) {
+    case OutputFormat::json:
+        return std::unique_ptr<ResultSerializer>(new JsonSerializer(capacity));
+    case OutputFormat::binary:
+        return std::unique_ptr<ResultSerializer>(new BinarySerializer(capacity));
+    default:
+        return std::unique_ptr<ResultSerializer>(new XmlSerializer(capacity));
+    }
+}
+
+/*
+ * _rowid_ is used because a column may be named rowid.
+ * A select of a whole table binds the smallest rowid , the query is the same and a
+ * scan continued after a drain is a range scan too.
+ */
+std::string DatabaseManager::querySelectAfter(const std::string &tableName)
+{
+    std::string query = "SELECT _rowid_ , * FROM " + tableName +
+                        " WHERE _rowid_ > ? ORDER BY _rowid_;";
     return query;
 }
 
-/* Fetches data from all tables in the database and returns it as an XML string.*/
-std::string DatabaseManager::fetchAllTablesAsXML()
+/*
+ * Fetches data from all tables in the database and passes it to sink.
+ * dbMutex is released between tables (and while sink drains) , so inserts are not
+ * blocked by the whole select.
+ */
+void DatabaseManager::fetchAllTables(OutputFormat format, ResultSink &sink)
+{
+    std::unique_ptr<ResultSerializer> serializer = makeSerializer(format);
+    sendToSink(serializer->header(true), sink);
+
+    std::vector<std::string> tableNames;
+    {
+        std::lock_guard<InstrumentedMutex> lock(dbMutex);
+
+        /*Get names of tables*/
+        tableNames = getAllTableNames();
+    }
+
+    for (size_t i = 0; i < tableNames.size(); i++) {
+        drainSink(sink);
+
+        std::unique_lock<InstrumentedMutex> lock = lockDatabase();
+        fetchTableLocked(lock, tableNames[i], *serializer, i == 0, sink);
+    }
+
+    sendToSink(serializer->footer(true), sink);
+}
+
+/*
+ * Fetches the rows after the watermark of each table and passes them to sink ,
+ * followed by the table _watermarks.
+ * Rowids grow with every insert (rows are never deleted) , so rows after the last
+ * watermark are the rows inserted since the previous poll.
+ * Like fetchAllTables , dbMutex is released between tables.
+ */
+void DatabaseManager::fetchChanges(
+    const std::vector<std::pair<std::string, long long>> &watermarks, OutputFormat format,
+    ResultSink &sink)
 {
-    std::ostringstream xmlStream;
+    std::vector<std::pair<std::string, long long>> tables = watermarks;
+    {
+        std::lock_guard<InstrumentedMutex> lock(dbMutex);
+
+        /*Names are checked against the schema , they are part of the query*/
+        std::vector<std::string> tableNames = getAllTableNames();
+        std::unordered_set<std::string> existing(tableNames.begin(), tableNames.end());
+
+        for (const auto &table : tables) {
+            if (! existing.count(table.first))
+                throw DatabaseException("Table not found : " + table.first + "\n");
+        }
+
+        if (tables.empty()) {
+            for (const std::string &tableName : tableNames)
+                tables.emplace_back(tableName, 0);
+        }
+    }
+
+    std::unique_ptr<ResultSerializer> serializer = makeSerializer(format);
+    sendToSink(serializer->header(true), sink);
+
+    std::vector<long long> rowids;
+
+    for (size_t i = 0; i < tables.size(); i++) {
+        drainSink(sink);
+
+        std::unique_lock<InstrumentedMutex> lock = lockDatabase();
+        long long rowid = fetchTableLocked(lock, tables[i].first, *serializer, i == 0, sink,
+                                           tables[i].second);
+        rowids.push_back(rowid);
+    }
+
+    serializer->clear();
+    serializer->beginTable("_watermarks", {"table", "rowid"}, tables.empty());
 
-    xmlStream << "<database>\n";
+    for (size_t i = 0; i < tables.size(); i++) {
+        std::string rowid = std::to_string(rowids[i]);
 
-    /*Get data for each table*/
-    std::vector<std::string> tableNames = getAllTableNames();
-    for (const std::string &tableName : tableNames) {
-        xmlStream << fetchTableDataAsXML(tableName);
+        serializer->beginRow();
+        serializer->appendValue(0, tables[i].first.c_str(), tables[i].first.size());
+        serializer->appendValue(1, rowid.c_str(), rowid.size());
+        serializer->endRow();
     }
+    serializer->endTable();
 
-    xmlStream << "</database>\n";
-    return xmlStream.str();
+    flushToSink(*serializer, sink);
+    sendToSink(serializer->footer(true), sink);
 }
 
 sqlite3 *DatabaseManager::getDatabase() const
@@ -0,0 +1,405 @@
+#include "serializer.hpp"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*Size of a NULL value in the binary format*/
+const uint32_t binaryNull = 0xFFFFFFFF;
+
+/*First bytes of a binary result , followed by the version*/
+const char binaryMagic[] = "DBMB";
+const char binaryVersion = 1;
+
+namespace SQLite
+{
+
+/**
+ *
+ * Implementation for "ResultSerializer" class
+ *
+ */
+
+ResultSerializer::ResultSerializer(size_t capacity)
+{
+    buffer.reserve(capacity);
+}
+
+ResultSerializer::~ResultSerializer()
+{
+}
+
+void ResultSerializer::clear()
+{
+    buffer.clear();
+}
+
+const std::string &ResultSerializer::getBuffer() const
+{
+    return buffer;
+}
+
+size_t ResultSerializer::size() const
+{
+    return buffer.size();
+}
+
+/**
+ *
+ * Implementation for "XmlSerializer" class
+ *
+ */
+
+XmlSerializer::XmlSerializer(size_t capacity) : ResultSerializer(capacity)
+{
+}
+
+std::string XmlSerializer::header(bool allTables) const
+{
+    return allTables ? "<database>\n" : "";
+}
+
+std::string XmlSerializer::footer(bool allTables) const
+{
+    return allTables ? "</database>\n" : "";
+}
+
+/* A table without columns is written as an empty element.*/
+void XmlSerializer::beginTable(const std::string &name, const std::vector<std::string> &columns,
+                               bool)
+{
+    tableName = name;
+    this->columns = columns;
+
+    buffer += '<';
+    buffer.append(name);
+    buffer.append(columns.empty() ? " />\n" : ">\n");
+}
+
+/* Names of columns are element names , they are not escaped.*/
+void XmlSerializer::appendValue(size_t column, const char *value, size_t size)
+{
+    const std::string &name = columns[column];
+
+    buffer.append("    <");
+    buffer.append(name);
+    buffer += '>';
+
+    if (value)
+        appendText(value, size);
+    else
+        buffer.append("NULL");
+
+    buffer.append("</");
+    buffer.append(name);
+    buffer.append(">\n");
+}
+
+void XmlSerializer::beginRow()
+{
+}
+
+void XmlSerializer::endRow()
+{
+}
+
+void XmlSerializer::endTable()
+{
+    if (columns.empty())
+        return;
+
+    buffer.append("</");
+    buffer.append(tableName);
+    buffer.append(">\n");
+}
+
+/*
+ * Appends text , the clean parts between special characters are copied at once.
+ * '>' is escaped too , so "]]>" in a value cannot end a CDATA section of the client.
+ */
+void XmlSerializer::appendText(const char *text, size_t size)
+{
+    size_t start = 0;
+    while (start < size) {
+        size_t special = start + findSpecial(text + start, size - start);
+        buffer.append(text + start, special - start);
+
+        if (special == size)
+            break;
+
+        switch (text[special]) {
+        case '<':
+            buffer.append("&lt;");
+            break;
+        case '>':
+            buffer.append("&gt;");
+            break;
+        default:
+            buffer.append("&amp;");
+            break;
+        }
+        start = special + 1;
+    }
+}
+
+/*
+ * Finds the first '<' , '>' or '&'.
+ * With SSE2 16 bytes are compared with the three characters at once , the mask of
+ * matches gives the position of the first one. The tail (and builds without SSE2)
+ * is checked byte by byte.
+ */
+size_t XmlSerializer::findSpecial(const char *text, size_t size)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i amp = _mm_set1_epi8('&');
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, lt),
+                                                  _mm_cmpeq_epi8(block, gt)),
+                                     _mm_cmpeq_epi8(block, amp));
+
+        int mask = _mm_movemask_epi8(found);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; i < size; i++) {
+        if (text[i] == '<' || text[i] == '>' || text[i] == '&')
+            return i;
+    }
+
+    return size;
+}
+
+/**
+ *
+ * Implementation for "JsonSerializer" class
+ *
+ */
+
+JsonSerializer::JsonSerializer(size_t capacity) : ResultSerializer(capacity), rows {0}
+{
+}
+
+std::string JsonSerializer::header(bool allTables) const
+{
+    return allTables ? "{\"tables\":[\n" : "";
+}
+
+std::string JsonSerializer::footer(bool allTables) const
+{
+    return allTables ? "\n]}\n" : "\n";
+}
+
+void JsonSerializer::beginTable(const std::string &name, const std::vector<std::string> &columns,
+                                bool first)
+{
+    tableName = name;
+    this->columns = columns;
+    rows = 0;
+
+    if (! first)
+        buffer.append(",\n");
+
+    buffer.append("{\"table\":");
+    appendString(name.c_str(), name.size());
+
+    buffer.append(",\"columns\":[");
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (i > 0)
+            buffer += ',';
+        appendString(columns[i].c_str(), columns[i].size());
+    }
+    buffer.append("],\"rows\":[");
+}
+
+void JsonSerializer::appendValue(size_t column, const char *value, size_t size)
+{
+    if (column > 0)
+        buffer += ',';
+
+    if (value)
+        appendString(value, size);
+    else
+        buffer.append("null");
+}
+
+/* One row for each line.*/
+void JsonSerializer::beginRow()
+{
+    buffer.append(rows++ > 0 ? ",\n[" : "\n[");
+}
+
+void JsonSerializer::endRow()
+{
+    buffer += ']';
+}
+
+void JsonSerializer::endTable()
+{
+    buffer.append(rows > 0 ? "\n]}" : "]}");
+}
+
+/* Appends a quoted string , clean parts are copied at once (like XmlSerializer).*/
+void JsonSerializer::appendString(const char *text, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    buffer += '"';
+
+    size_t start = 0;
+    while (start < size) {
+        size_t special = start + findSpecial(text + start, size - start);
+        buffer.append(text + start, special - start);
+
+        if (special == size)
+            break;
+
+        unsigned char c = text[special];
+        switch (c) {
+        case '"':
+            buffer.append("\\\"");
+            break;
+        case '\\':
+            buffer.append("\\\\");
+            break;
+        case '\n':
+            buffer.append("\\n");
+            break;
+        case '\r':
+            buffer.append("\\r");
+            break;
+        case '\t':
+            buffer.append("\\t");
+            break;
+        default:
+            buffer.append("\\u00");
+            buffer += hex[c >> 4];
+            buffer += hex[c & 0xF];
+            break;
+        }
+        start = special + 1;
+    }
+
+    buffer += '"';
+}
+
+/*
+ * Finds the first '"' , '\' or control character (below 0x20).
+ * With SSE2 a byte is a control character if max(byte , 0x1F) == 0x1F (unsigned),
+ * bytes of UTF-8 sequences (0x80 and above) are not special.
+ */
+size_t JsonSerializer::findSpecial(const char *text, size_t size)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                                                  _mm_cmpeq_epi8(block, backslash)),
+                                     _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+
+        int mask = _mm_movemask_epi8(found);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; i < size; i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\' || c < 0x20)
+            return i;
+    }
+
+    return size;
+}
+
+/**
+ *
+ * Implementation for "BinarySerializer" class
+ *
+ */
+
+BinarySerializer::BinarySerializer(size_t capacity) : ResultSerializer(capacity)
+{
+}
+
+std::string BinarySerializer::header(bool) const
+{
+    std::string header = binaryMagic;
+    header += binaryVersion;
+
+    return header;
+}
+
+std::string BinarySerializer::footer(bool) const
+{
+    return "Z";
+}
+
+/* Names of columns are written once for the table.*/
+void BinarySerializer::beginTable(const std::string &name,
+                                  const std::vector<std::string> &columns, bool)
+{
+    tableName = name;
+    this->columns = columns;
+
+    buffer += 'T';
+    appendBytes(name.c_str(), name.size());
+
+    appendUint32(columns.size());
+    for (const std::string &column : columns)
+        appendBytes(column.c_str(), column.size());
+}
+
+void BinarySerializer::appendValue(size_t, const char *value, size_t size)
+{
+    if (value)
+        appendBytes(value, size);
+    else
+        appendUint32(binaryNull);
+}
+
+void BinarySerializer::beginRow()
+{
+    buffer += 'R';
+}
+
+void BinarySerializer::endRow()
+{
+}
+
+void BinarySerializer::endTable()
+{
+    buffer += 'E';
+}
+
+void BinarySerializer::appendUint32(uint32_t value)
+{
+    char bytes[4];
+    for (int i = 0; i < 4; i++)
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+
+    buffer.append(bytes, sizeof(bytes));
+}
+
+void BinarySerializer::appendBytes(const char *data, size_t size)
+{
+    appendUint32(size);
+    buffer.append(data, size);
+}
+
+} /* namespace SQLite */
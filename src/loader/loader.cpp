@@ -0,0 +1,310 @@
+#include "loader.hpp"
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+/**
+ *
+ * Implementation for "MappedFile" class
+ *
+ */
+
+MappedFile::MappedFile(const std::string &path) : data {nullptr}, size {0}
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw LoaderException("Unable to open file\n");
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0) {
+        close(fd);
+        throw LoaderException("Unable to read size of file\n");
+    }
+
+    if (fileStat.st_size == 0) {
+        close(fd);
+        throw LoaderException("File is empty\n");
+    }
+
+    void *address = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /*The mapping stays valid after the descriptor is closed*/
+    close(fd);
+
+    if (address == MAP_FAILED)
+        throw LoaderException("Unable to map file\n");
+
+    /*The parser reads the file once from start to end*/
+    madvise(address, fileStat.st_size, MADV_SEQUENTIAL);
+    madvise(address, fileStat.st_size, MADV_WILLNEED);
+
+    data = static_cast<const char *>(address);
+    size = fileStat.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+        munmap(const_cast<char *>(data), size);
+}
+
+const char *MappedFile::getData() const
+{
+    return data;
+}
+size_t MappedFile::getSize() const
+{
+    return size;
+}
+
+/**
+ *
+ * Implementation for "BulkLoader" class
+ *
+ */
+
+BulkLoader::BulkLoader(Configuration &configuration, const std::string &path) :
+    configuration {configuration},
+    path {path},
+    batchSize {static_cast<size_t>(configuration.getPerformanceConfig().getLoaderBatchSize())},
+    queueCapacity {static_cast<size_t>(configuration.getPerformanceConfig().getLoaderQueueSize())},
+    nextFile {0},
+    runningWorkers {0},
+    parsedFiles {0},
+    parsedBytes {0},
+    storedFiles {0},
+    failedFiles {0},
+    duplicateFiles {0}
+{
+}
+
+/*
+ * Loads all files of path :
+ * 1.Collects the files.
+ * 2.Starts one writer and several parse workers.
+ * 3.Waits for workers and writer and prints the final throughput.
+ */
+void BulkLoader::run()
+{
+    collectFiles(path);
+    if (files.empty())
+        throw LoaderException("No xml file found in " + path + "\n");
+
+    std::sort(files.begin(), files.end());
+
+    size_t workersNum =
+        std::min(configuration.getPerformanceConfig().getWorkerCount(), files.size());
+
+    std::cout << "Loading " << files.size() << " files with " << workersNum
+              << " parse workers.\n";
+
+    SQLite::DatabaseManager database {configuration.getDatabaseConfig(),
+                                      configuration.getPerformanceConfig()};
+    XML::Parser parser {static_cast<size_t>(
+        configuration.getPerformanceConfig().getPlanCacheSize())};
+
+    /*Initializes libxml2 once before workers use it*/
+    xmlInitParser();
+
+    startTime = std::chrono::steady_clock::now();
+    runningWorkers = workersNum;
+
+    std::thread writer(&BulkLoader::writeDocuments, this, &database);
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workersNum; i++)
+        workers.emplace_back(&BulkLoader::parseFiles, this, &parser);
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    writer.join();
+
+    printProgress(true);
+}
+
+/* Collects the file , or the .xml files of the directory (recursively).*/
+void BulkLoader::collectFiles(const std::string &path)
+{
+    struct stat pathStat;
+    if (stat(path.c_str(), &pathStat) < 0)
+        throw LoaderException("Unable to open path: " + path + "\n");
+
+    if (S_ISREG(pathStat.st_mode)) {
+        files.push_back(path);
+        return;
+    }
+
+    if (! S_ISDIR(pathStat.st_mode))
+        return;
+
+    DIR *directory = opendir(path.c_str());
+    if (! directory)
+        throw LoaderException("Unable to open directory: " + path + "\n");
+
+    while (dirent *entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        std::string entryPath = path + "/" + name;
+
+        struct stat entryStat;
+        if (stat(entryPath.c_str(), &entryStat) < 0)
+            continue;
+
+        if (S_ISDIR(entryStat.st_mode)) {
+            collectFiles(entryPath);
+        } else if (S_ISREG(entryStat.st_mode) && name.size() > 4 &&
+                   name.compare(name.size() - 4, 4, ".xml") == 0) {
+            files.push_back(entryPath);
+        }
+    }
+    closedir(directory);
+}
+
+/*
+ * Parse worker : takes the next file , maps it , builds the tree with the
+ * context of this worker and passes the rows to the writer.
+ * A file that cannot be loaded is reported and skipped.
+ */
+void BulkLoader::parseFiles(XML::Parser *parser)
+{
+    XML::ParserContext parserContext {configuration.getParserConfig()};
+
+    for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+        try {
+            MappedFile file {files[i]};
+
+            size_t documentSize = 0;
+            xmlDocPtr xmlDoc = parserContext.read(file.getData(), file.getSize(),
+                                                  XML::Compression::none, documentSize);
+
+            /*Files with a known shape do not build a tree*/
+            SQLite::DocumentRows document;
+            std::unique_ptr<XML::Tree> tree {
+                parser->collectDocument(xmlDoc, documentSize, document)};
+
+            if (tree && tree->getIsSelectType())
+                throw LoaderException("Select request can not be loaded\n");
+
+            parsedFiles++;
+            parsedBytes += file.getSize();
+
+            pushDocument(files[i], std::move(document));
+
+        } catch (const std::exception &e) {
+            failedFiles++;
+            printError(files[i], e.what());
+        }
+    }
+
+    /*The writer stops when the last worker is finished and the queue is empty*/
+    {
+        std::lock_guard<std::mutex> lock(queueMtx);
+        runningWorkers--;
+    }
+    queueNotEmpty.notify_one();
+}
+
+/* Pushes parsed xml data to the queue , waits while the writer is behind.*/
+void BulkLoader::pushDocument(const std::string &path, SQLite::DocumentRows &&document)
+{
+    std::unique_lock<std::mutex> lock(queueMtx);
+    queueNotFull.wait(lock, [this] { return documents.size() < queueCapacity; });
+
+    documents.emplace_back(path, std::move(document));
+
+    if (documents.size() >= batchSize)
+        queueNotEmpty.notify_one();
+}
+
+/*
+ * Writer : takes up to one batch of xml data from the queue and stores it in
+ * one transaction. Prints the progress about once a second.
+ */
+void BulkLoader::writeDocuments(SQLite::DatabaseManager *database)
+{
+    std::vector<SQLite::DocumentRows> batch;
+
+    /*Path of the file of each xml data in batch*/
+    std::vector<std::string> paths;
+    auto lastReport = std::chrono::steady_clock::now();
+
+    while (true) {
+        bool finished;
+        {
+            std::unique_lock<std::mutex> lock(queueMtx);
+            queueNotEmpty.wait_for(lock, std::chrono::seconds(1), [this] {
+                return documents.size() >= batchSize || runningWorkers == 0;
+            });
+
+            while (! documents.empty() && batch.size() < batchSize) {
+                paths.push_back(std::move(documents.front().first));
+                batch.push_back(std::move(documents.front().second));
+                documents.pop_front();
+            }
+
+            finished = documents.empty() && runningWorkers == 0;
+        }
+        queueNotFull.notify_all();
+
+        if (! batch.empty()) {
+            std::vector<std::pair<size_t, std::string>> errors;
+            try {
+                size_t duplicates = 0;
+                storedFiles += database->insertDocuments(batch, errors, duplicates);
+                duplicateFiles += duplicates;
+                failedFiles += errors.size();
+
+                for (const auto &error : errors)
+                    printError(paths[error.first], error.second);
+
+            } catch (const SQLite::DatabaseException &de) {
+                failedFiles += batch.size();
+                printError("batch", de.what());
+            }
+            batch.clear();
+            paths.clear();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            printProgress(false);
+            lastReport = now;
+        }
+
+        if (finished)
+            break;
+    }
+}
+
+/* Prints the number of loaded files and the throughput since start.*/
+void BulkLoader::printProgress(bool final)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    double seconds = std::max(elapsed.count(), 0.001);
+    double megabytes = parsedBytes / (1024.0 * 1024.0);
+
+    std::lock_guard<std::mutex> lock(coutMtx);
+    std::cout << (final ? "Done : " : "Progress : ") << storedFiles << "/" << files.size()
+              << " files stored , " << failedFiles << " failed , " << duplicateFiles
+              << " already stored , " << megabytes << " MB in "
+              << seconds << " s (" << storedFiles / seconds << " files/s , "
+              << megabytes / seconds << " MB/s)\n";
+}
+
+/* Prints an error for one file.*/
+void BulkLoader::printError(const std::string &file, const std::string &message)
+{
+    std::lock_guard<std::mutex> lock(coutMtx);
+    std::cerr << "Error : " << file << " : " << message;
+
+    if (message.empty() || message.back() != '\n')
+        std::cerr << "\n";
+}
@@ -1,8 +1,15 @@
 #include "database.hpp"
+#include "loader.hpp"
+#include "metrics.hpp"
 #include "parser.hpp"
 #include "socket.hpp"
+#include "trace.hpp"
 
+#include <csignal>
+#include <cstring>
 #include <iostream>
+#include <pthread.h>
+#include <unordered_set>
 
 class Application
 {
@@ -13,35 +20,59 @@ public:
         /* Configuration program.*/
         configuration.config(argc, argv);
 
+        /* Bulk load mode : load files and exit without starting the server.*/
+        if (! configuration.getImportPath().empty()) {
+            importFiles();
+            return;
+        }
+
+        applyTraceConfiguration();
+
+        /* Server signals are received by sigwait , every thread inherits the blocked mask.*/
+        sigset_t signals = serverSignals();
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
         /* Initialize and start the socket server.*/
         server();
 
         std::this_thread::sleep_for(std::chrono::seconds(1));
         if (socket->isOpen()) {
-            std::cout << "Server started. Press Enter to stop...\n\n";
+            std::cout << "Server started. Press Enter or send SIGTERM to stop...\n\n";
 
-            /*Start the thread that waits for user input to stop the server.*/
-            stopServerThread = std::thread([this]() {
-                /*Wait for user input*/
-                std::cin.get();
-                socket->stop();
+            /*
+             * Start the thread that waits for user input to stop the server.
+             * Enter stops the server like SIGTERM , end of input (no console) is ignored.
+             */
+            stopServerThread = std::thread([]() {
+                if (std::cin.get() != EOF)
+                    kill(getpid(), SIGTERM);
             });
+            stopServerThread.detach();
 
             /*Process incoming client data */
             processAndStoreClientData();
 
+            waitForSignals();
+
+            drainServer();
+
         } else
 
             std::cout << "Server failed to start. Check logs for "
                          "errors.\n";
     }
-    Application() : socket {nullptr}, databaseManager {nullptr}, xmlParser {nullptr}
+    Application() :
+        socket {nullptr},
+        databaseManager {nullptr},
+        xmlParser {nullptr},
+        runningWorkers {0},
+        targetWorkers {0}
     {
     }
     /* Destructor cleans up resources and stops the server if running */
     ~Application()
     {
-        if (socket->isOpen())
+        if (socket && socket->isOpen())
             socket->stop();
 
         if (serverThread.joinable())
@@ -71,9 +102,154 @@ private:
 
     std::thread serverThread;
 
+    /* Worker threads that parse and store client data.*/
+    std::vector<std::thread> workers;
+
+    /* Number of running workers and configured workers (guarded by the socket mutex).*/
+    size_t runningWorkers;
+    size_t targetWorkers;
+
+    /* Workers that left the pool and are not joined yet (guarded by the socket mutex).*/
+    std::vector<std::thread::id> finishedWorkers;
+
     /* Thread to handle server stopping on user input.*/
     std::thread stopServerThread;
 
+    /*
+     * Returns the signals handled by the server : SIGINT , SIGTERM (stop) , SIGHUP (reload)
+     * and SIGUSR1 (write the trace file).
+     */
+    static sigset_t serverSignals()
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGHUP);
+        sigaddset(&signals, SIGUSR1);
+
+        return signals;
+    }
+
+    /*
+     * Waits for a stop signal , reloads the configuration on SIGHUP and writes the
+     * trace file on SIGUSR1.
+     * The capture file is flushed every period , so a crash loses about a second of it.
+     * Returns also if the server stopped by itself.
+     */
+    void waitForSignals()
+    {
+        sigset_t signals = serverSignals();
+        timespec period {1, 0};
+
+        while (socket->isOpen()) {
+            int signal = sigtimedwait(&signals, nullptr, &period);
+            socket->flushCapture();
+
+            if (signal == SIGHUP) {
+                reloadConfiguration();
+
+            } else if (signal == SIGUSR1) {
+                writeTrace();
+
+            } else if (signal > 0) {
+                std::cout << "Received " << strsignal(signal) << " : draining...\n";
+                return;
+            }
+        }
+    }
+
+    /*
+     * Reloads config.json and applies the runtime settings to the socket , the
+     * database and the worker pool. Every change is printed by the configuration.
+     */
+    void reloadConfiguration()
+    {
+        std::cout << "Received SIGHUP : reloading configuration...\n";
+
+        if (! configuration.reload())
+            return;
+
+        socket->applyConfiguration(configuration.getServerConfig());
+
+        try {
+            databaseManager->tune(configuration.getPerformanceConfig());
+
+        } catch (const SQLite::DatabaseException &de) {
+            std::cerr << "Error : " << de.what();
+        }
+
+        xmlParser->setPlanCacheSize(configuration.getPerformanceConfig().getPlanCacheSize());
+
+        resizeWorkers(configuration.getPerformanceConfig().getWorkerCount());
+
+        applyTraceConfiguration();
+
+        Metrics::instance().counter("config.reloads").add();
+    }
+
+    /* Sets the sampling of the tracer , the buffer size only applies to new threads.*/
+    void applyTraceConfiguration()
+    {
+        TraceConfiguration &traceConfig = configuration.getTraceConfig();
+
+        Tracer::instance().setSampleRate(traceConfig.getSampleRate());
+        Tracer::instance().setBufferSize(traceConfig.getBufferSize());
+    }
+
+    /* Writes the spans of sampled requests to the trace file (chrome trace format).*/
+    void writeTrace()
+    {
+        const std::string &path = configuration.getTraceConfig().getPath();
+
+        try {
+            size_t spans = Tracer::instance().writeChromeJSON(path);
+            std::cout << "Trace : " << spans << " spans written to " << path << ".\n";
+
+        } catch (const std::exception &e) {
+            std::cerr << "Error : " << e.what();
+        }
+    }
+
+    /*
+     * Stops the server without losing accepted requests :
+     * 1.Stops accepting and finishes queued and in-flight requests (drainTimeout).
+     * 2.Joins the accept thread and the workers , so no transaction is open.
+     * 3.Checkpoints the write-ahead log.
+     * The database is closed later by the destructor.
+     */
+    void drainServer()
+    {
+        socket->drain(configuration.getServerConfig().getDrainTimeout());
+
+        if (serverThread.joinable())
+            serverThread.join();
+
+        for (std::thread &worker : workers)
+            worker.join();
+
+        try {
+            databaseManager->checkpoint();
+
+        } catch (const SQLite::DatabaseException &de) {
+            std::cerr << "Error : " << de.what();
+        }
+
+        std::cout << "Server drained.\n";
+    }
+
+    /* Loads the files given by -i into the database */
+    void importFiles()
+    {
+        try {
+            BulkLoader loader {configuration, configuration.getImportPath()};
+            loader.run();
+
+        } catch (const std::exception &e) {
+            std::cerr << "Error : " << e.what();
+        }
+    }
+
     /* Initializes the socket and starts the server in a separate thread */
     void server()
     {
@@ -81,38 +257,110 @@ private:
         serverThread = std::thread(&Socket::createSocket, socket);
     }
 
-    /* Processes incoming client data and stores it in the database */
+    /* Starts the workers that process incoming client data and store it in the database */
     void processAndStoreClientData()
     {
-        xmlParser = new XML::Parser {};
-        databaseManager = new SQLite::DatabaseManager {configuration.getDatabaseConfig()};
+        xmlParser = new XML::Parser {
+            static_cast<size_t>(configuration.getPerformanceConfig().getPlanCacheSize())};
+        databaseManager = new SQLite::DatabaseManager {configuration.getDatabaseConfig(),
+                                                       configuration.getPerformanceConfig()};
+
+        /*Initializes libxml2 once before workers use it*/
+        xmlInitParser();
+
+        resizeWorkers(configuration.getPerformanceConfig().getWorkerCount());
+    }
+
+    /*
+     * Changes the number of workers : missing workers are started at once , extra
+     * workers leave the pool when no waiting request can be taken.
+     * Workers that already left are joined here.
+     */
+    void resizeWorkers(size_t count)
+    {
+        size_t newWorkers = 0;
+        std::unordered_set<std::thread::id> finished;
+        {
+            std::lock_guard<InstrumentedMutex> lock(socket->getMutex());
+            targetWorkers = count;
+
+            if (runningWorkers < targetWorkers) {
+                newWorkers = targetWorkers - runningWorkers;
+                runningWorkers = targetWorkers;
+            }
+
+            finished.insert(finishedWorkers.begin(), finishedWorkers.end());
+            finishedWorkers.clear();
+        }
+        /*Wakes extra workers so they can leave*/
+        socket->getCV().notify_all();
+
+        for (auto it = workers.begin(); it != workers.end();) {
+            if (finished.count(it->get_id())) {
+                it->join();
+                it = workers.erase(it);
+            } else
+                ++it;
+        }
+
+        for (size_t i = 0; i < newWorkers; i++)
+            workers.emplace_back(&Application::processClients, this);
+    }
+
+    /*
+     * Worker loop : takes clients from the scheduler and processes their data.
+     * Each worker owns a parser context that is reused for all of its documents.
+     */
+    void processClients()
+    {
+        XML::ParserContext parserContext {configuration.getParserConfig()};
 
         while (true)
 
         {
-            std::unique_lock<std::mutex> lock(socket->getMutex());
+            InstrumentedLock lock(socket->getMutex());
 
-            /*Wait for data from clients or server stop signal.*/
+            /*Wait for a request to take , server stop signal or a smaller pool.*/
             socket->getCV().wait(lock, [this] {
-                return ! socket->getWaitingClients().empty() || ! socket->isOpen();
+                return socket->getScheduler().hasRunnable() || ! socket->isOpen() ||
+                       runningWorkers > targetWorkers;
             });
 
-            /* Break if server is stopped and no more waiting clients*/
-            if (! socket->isOpen() && socket->getWaitingClients().empty())
+            /* Get the next client from the scheduler*/
+            RequestClass requestClass;
+            Client *client = socket->getScheduler().pop(requestClass);
+
+            /*
+             * Break if server is stopped or the pool is too large , and no request can be taken.
+             * Selects waiting for a select worker are taken by the workers processing selects.
+             */
+            if (! client) {
+                if (runningWorkers > targetWorkers) {
+                    runningWorkers--;
+                    finishedWorkers.push_back(std::this_thread::get_id());
+                }
                 break;
+            }
 
-            /* Get client from waiting queue and pop it*/
-            Client *client = socket->getWaitingClients().front();
-            socket->getWaitingClients().pop();
+            lock.unlock();
 
-            /*Start a thread to process the XML data from the client.*/
-            std::thread parseThread(&XML::Parser::parseAndStoreXmlData, xmlParser, client,
-                                    databaseManager);
+            /*Spans of the worker belong to the request of the client*/
+            uint64_t traceId = client->getTraceId();
+            Tracer::instance().record(traceId, "queue", client->getQueuedAt(),
+                                      std::chrono::steady_clock::now());
+            Tracer::setCurrent(traceId);
 
-            parseThread.detach();
+            /*Process the XML data from the client.*/
+            xmlParser->parseAndStoreXmlData(client, databaseManager, &parserContext);
 
-            /*Store the parsing thread in clien*/
-            client->setParseThread(std::move(parseThread));
+            Tracer::setCurrent(0);
+
+            /*A finished select frees a select worker for a waiting select*/
+            if (requestClass == RequestClass::select) {
+                lock.lock();
+                if (socket->getScheduler().finished(requestClass))
+                    socket->getCV().notify_one();
+            }
         }
     }
 };
@@ -120,7 +368,14 @@ private:
 int main(int argc, char *argv[])
 {
     Application app;
-    app.run(argc, argv);
+
+    try {
+        app.run(argc, argv);
+
+    } catch (const std::exception &e) {
+        std::cerr << "Error : " << e.what();
+        return 1;
+    }
 
     return 0;
 }
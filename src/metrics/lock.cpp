@@ -0,0 +1,155 @@
+#include "lock.hpp"
+
+#include "metrics.hpp"
+
+/**
+ *
+ * Implementation for "LockHistogram" class
+ *
+ */
+
+LockHistogram::LockHistogram() : total {0}, max {0}
+{
+    for (std::atomic<long long> &bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+/* The bucket of a duration is the number of bits of its nanoseconds.*/
+void LockHistogram::add(long long nanoseconds)
+{
+    int bucket = 0;
+    if (nanoseconds > 0)
+        bucket = 64 - __builtin_clzll(static_cast<unsigned long long>(nanoseconds));
+
+    if (bucket >= bucketCount)
+        bucket = bucketCount - 1;
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    long long longest = max.load(std::memory_order_relaxed);
+    while (nanoseconds > longest &&
+           ! max.compare_exchange_weak(longest, nanoseconds, std::memory_order_relaxed))
+        ;
+}
+
+void LockHistogram::toXML(std::ostream &xmlStream, const char *tag) const
+{
+    for (int i = 0; i < bucketCount; i++) {
+        long long count = buckets[i].load(std::memory_order_relaxed);
+        if (count == 0)
+            continue;
+
+        xmlStream << "        <" << tag << " below=\"";
+        if (i == bucketCount - 1)
+            xmlStream << "inf";
+        else
+            xmlStream << (1LL << i);
+        xmlStream << "\">" << count << "</" << tag << ">\n";
+    }
+}
+
+long long LockHistogram::getTotal() const
+{
+    return total.load(std::memory_order_relaxed);
+}
+
+long long LockHistogram::getMax() const
+{
+    return max.load(std::memory_order_relaxed);
+}
+
+/**
+ *
+ * Implementation for "LockStats" class
+ *
+ */
+
+LockStats::LockStats() : acquisitions {0}, contentions {0}
+{
+}
+
+void LockStats::acquired(bool contended, long long waitNanoseconds)
+{
+    acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+    if (contended)
+        contentions.fetch_add(1, std::memory_order_relaxed);
+
+    wait.add(waitNanoseconds);
+}
+
+void LockStats::released(long long holdNanoseconds)
+{
+    hold.add(holdNanoseconds);
+}
+
+/* Totals and maxima are in nanoseconds , followed by the wait and hold histograms.*/
+void LockStats::toXML(std::ostream &xmlStream, const std::string &name) const
+{
+    xmlStream << "    <lock name=\"" << name << "\" acquisitions=\""
+              << acquisitions.load(std::memory_order_relaxed) << "\" contentions=\""
+              << contentions.load(std::memory_order_relaxed) << "\" waitNs=\""
+              << wait.getTotal() << "\" maxWaitNs=\"" << wait.getMax() << "\" holdNs=\""
+              << hold.getTotal() << "\" maxHoldNs=\"" << hold.getMax() << "\">\n";
+
+    wait.toXML(xmlStream, "wait");
+    hold.toXML(xmlStream, "hold");
+
+    xmlStream << "    </lock>\n";
+}
+
+#ifdef DBM_LOCK_STATS
+
+/* Returns nanoseconds between two time points.*/
+static long long nanoseconds(std::chrono::steady_clock::time_point start,
+                             std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+/**
+ *
+ * Implementation for "InstrumentedMutex" class
+ *
+ */
+
+InstrumentedMutex::InstrumentedMutex(const char *name) :
+    stats {Metrics::instance().lockStats(name)}
+{
+}
+
+void InstrumentedMutex::lock()
+{
+    if (mutex.try_lock()) {
+        acquiredAt = std::chrono::steady_clock::now();
+        stats.acquired(false, 0);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    mutex.lock();
+    acquiredAt = std::chrono::steady_clock::now();
+
+    stats.acquired(true, nanoseconds(start, acquiredAt));
+}
+
+void InstrumentedMutex::unlock()
+{
+    long long held = nanoseconds(acquiredAt, std::chrono::steady_clock::now());
+    mutex.unlock();
+
+    stats.released(held);
+}
+
+bool InstrumentedMutex::try_lock()
+{
+    if (! mutex.try_lock())
+        return false;
+
+    acquiredAt = std::chrono::steady_clock::now();
+    stats.acquired(false, 0);
+    return true;
+}
+
+#endif
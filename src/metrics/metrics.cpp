@@ -0,0 +1,99 @@
+#include "metrics.hpp"
+
+#include <sstream>
+
+/**
+ *
+ * Implementation for "Counter" class
+ *
+ */
+
+Counter::Counter() : value {0}
+{
+}
+
+void Counter::add(long long value)
+{
+    this->value.fetch_add(value, std::memory_order_relaxed);
+}
+
+long long Counter::get() const
+{
+    return value.load(std::memory_order_relaxed);
+}
+
+/**
+ *
+ * Implementation for "Metrics" class
+ *
+ */
+
+Metrics::Metrics() : startTime {std::chrono::steady_clock::now()}
+{
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Counter &Metrics::counter(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(metricsMtx);
+
+    std::unique_ptr<Counter> &counter = counters[name];
+    if (! counter)
+        counter.reset(new Counter);
+
+    return *counter;
+}
+
+LockStats &Metrics::lockStats(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(metricsMtx);
+
+    std::unique_ptr<LockStats> &stats = locks[name];
+    if (! stats)
+        stats.reset(new LockStats);
+
+    return *stats;
+}
+
+LockHistogram &Metrics::histogram(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(metricsMtx);
+
+    std::unique_ptr<LockHistogram> &histogram = histograms[name];
+    if (! histogram)
+        histogram.reset(new LockHistogram);
+
+    return *histogram;
+}
+
+/* Returns all metrics as xml , one element for each counter , histogram and lock.*/
+std::string Metrics::toXML()
+{
+    std::lock_guard<std::mutex> lock(metricsMtx);
+    std::ostringstream xmlStream;
+
+    auto uptime = std::chrono::steady_clock::now() - startTime;
+    xmlStream << "<stats uptimeMs=\""
+              << std::chrono::duration_cast<std::chrono::milliseconds>(uptime).count() << "\">\n";
+    for (const auto &counter : counters) {
+        xmlStream << "    <counter name=\"" << counter.first << "\">" << counter.second->get()
+                  << "</counter>\n";
+    }
+    for (const auto &histogram : histograms) {
+        xmlStream << "    <histogram name=\"" << histogram.first << "\" totalNs=\""
+                  << histogram.second->getTotal() << "\" maxNs=\"" << histogram.second->getMax()
+                  << "\">\n";
+        histogram.second->toXML(xmlStream, "duration");
+        xmlStream << "    </histogram>\n";
+    }
+    for (const auto &stats : locks)
+        stats.second->toXML(xmlStream, stats.first);
+    xmlStream << "</stats>\n";
+
+    return xmlStream.str();
+}
@@ -0,0 +1,282 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*Trace id of the request the thread is working on*/
+static thread_local uint64_t currentTraceId = 0;
+
+/*Returns the kernel id of the calling thread (the tid shown by top and perf)*/
+static int threadId()
+{
+    static thread_local int id = static_cast<int>(syscall(SYS_gettid));
+    return id;
+}
+
+/*
+ * Owner of the buffer of a thread , gives the buffer back to the tracer when the
+ * thread exits.
+ */
+struct TraceBufferOwner
+{
+    TraceBuffer *buffer = nullptr;
+
+    ~TraceBufferOwner()
+    {
+        if (buffer)
+            Tracer::instance().releaseBuffer(buffer);
+    }
+};
+
+static thread_local TraceBufferOwner bufferOwner;
+
+/**
+ *
+ * Implementation for "TraceBuffer" class
+ *
+ */
+
+TraceBuffer::TraceBuffer(size_t capacity) :
+    slots {new Slot[std::max<size_t>(capacity, 1)]},
+    capacity {std::max<size_t>(capacity, 1)},
+    head {0}
+{
+    for (size_t i = 0; i < this->capacity; i++)
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * The sequence of a slot is 2 * index + 1 while the span with this index is
+ * written and 2 * index + 2 once it is complete.
+ */
+void TraceBuffer::record(const TraceEvent &event)
+{
+    uint64_t index = head.load(std::memory_order_relaxed);
+    Slot &slot = slots[index % capacity];
+
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.event = event;
+
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    head.store(index + 1, std::memory_order_release);
+}
+
+/* Copies the complete slots , a slot overwritten during the copy is skipped.*/
+void TraceBuffer::collect(std::vector<TraceEvent> &events) const
+{
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+
+    for (uint64_t index = begin; index < end; index++) {
+        const Slot &slot = slots[index % capacity];
+
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2)
+            continue;
+
+        TraceEvent event = slot.event;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        events.push_back(event);
+    }
+}
+
+/**
+ *
+ * Implementation for "Tracer" class
+ *
+ */
+
+Tracer::Tracer() :
+    startTime {std::chrono::steady_clock::now()},
+    sampleRate {0},
+    bufferSize {8192},
+    requests {0},
+    lastTraceId {0}
+{
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+uint64_t Tracer::startRequest()
+{
+    int rate = sampleRate.load(std::memory_order_relaxed);
+    if (rate <= 0)
+        return 0;
+
+    if (requests.fetch_add(1, std::memory_order_relaxed) % rate != 0)
+        return 0;
+
+    return lastTraceId.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void Tracer::record(uint64_t traceId, const char *name,
+                    std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end)
+{
+    if (traceId == 0)
+        return;
+
+    TraceEvent event;
+    event.traceId = traceId;
+    event.name = name;
+    event.start =
+        std::chrono::duration_cast<std::chrono::microseconds>(start - startTime).count();
+    event.duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    event.thread = threadId();
+
+    threadBuffer()->record(event);
+}
+
+std::string Tracer::toChromeJSON()
+{
+    return chromeJSON(collectEvents());
+}
+
+size_t Tracer::writeChromeJSON(const std::string &path)
+{
+    std::vector<TraceEvent> events = collectEvents();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (! file.is_open())
+        throw std::runtime_error("Failed to open trace file : " + path + "\n");
+
+    file << chromeJSON(events);
+    if (! file)
+        throw std::runtime_error("Failed to write trace file : " + path + "\n");
+
+    return events.size();
+}
+
+/* Returns the spans of all buffers , sorted by start time.*/
+std::vector<TraceEvent> Tracer::collectEvents()
+{
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(buffersMtx);
+        for (const auto &buffer : buffers)
+            buffer->collect(events);
+    }
+
+    std::sort(events.begin(), events.end(),
+              [](const TraceEvent &a, const TraceEvent &b) { return a.start < b.start; });
+
+    return events;
+}
+
+/*
+ * Every span is a complete event ("ph":"X") with its own duration , names are
+ * literals of the program and need no escaping.
+ */
+std::string Tracer::chromeJSON(const std::vector<TraceEvent> &events)
+{
+    std::ostringstream jsonStream;
+    int pid = getpid();
+
+    jsonStream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent &event = events[i];
+        jsonStream << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << event.name
+                   << "\",\"cat\":\"dbm\",\"ph\":\"X\",\"ts\":" << event.start
+                   << ",\"dur\":" << event.duration << ",\"pid\":" << pid
+                   << ",\"tid\":" << event.thread << ",\"args\":{\"trace\":" << event.traceId
+                   << "}}";
+    }
+    jsonStream << "\n]}\n";
+
+    return jsonStream.str();
+}
+
+TraceBuffer *Tracer::threadBuffer()
+{
+    if (bufferOwner.buffer)
+        return bufferOwner.buffer;
+
+    std::lock_guard<std::mutex> lock(buffersMtx);
+    if (! freeBuffers.empty()) {
+        bufferOwner.buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+    } else {
+        buffers.emplace_back(new TraceBuffer {bufferSize.load(std::memory_order_relaxed)});
+        bufferOwner.buffer = buffers.back().get();
+    }
+
+    return bufferOwner.buffer;
+}
+
+/* The spans of the buffer are kept , the next thread continues the ring.*/
+void Tracer::releaseBuffer(TraceBuffer *buffer)
+{
+    std::lock_guard<std::mutex> lock(buffersMtx);
+    freeBuffers.push_back(buffer);
+}
+
+void Tracer::setCurrent(uint64_t traceId)
+{
+    currentTraceId = traceId;
+}
+
+uint64_t Tracer::getCurrent()
+{
+    return currentTraceId;
+}
+
+int Tracer::getSampleRate() const
+{
+    return sampleRate.load(std::memory_order_relaxed);
+}
+
+size_t Tracer::getBufferSize() const
+{
+    return bufferSize.load(std::memory_order_relaxed);
+}
+
+void Tracer::setSampleRate(int sampleRate)
+{
+    this->sampleRate.store(sampleRate, std::memory_order_relaxed);
+}
+
+/* Only buffers created after the change have the new size.*/
+void Tracer::setBufferSize(size_t bufferSize)
+{
+    this->bufferSize.store(bufferSize, std::memory_order_relaxed);
+}
+
+/**
+ *
+ * Implementation for "TraceSpan" class
+ *
+ */
+
+TraceSpan::TraceSpan(const char *name) : name {name}, traceId {currentTraceId}
+{
+    if (traceId != 0)
+        start = std::chrono::steady_clock::now();
+}
+
+TraceSpan::~TraceSpan()
+{
+    end();
+}
+
+void TraceSpan::end()
+{
+    if (traceId == 0)
+        return;
+
+    Tracer::instance().record(traceId, name, start, std::chrono::steady_clock::now());
+    traceId = 0;
+}
@@ -0,0 +1,144 @@
+#include "context.hpp"
+
+#include "tree.hpp"
+
+#include <zlib.h>
+
+/*Size of inflated chunks pushed to the parser*/
+const size_t inflateChunkSize = 64 * 1024;
+
+namespace XML
+{
+
+/**
+ *
+ * Implementation for "ParserContext" class
+ *
+ */
+
+ParserContext::ParserContext(const ParserConfiguration &parserConfig) :
+    options {0},
+    maxInflatedSize {static_cast<unsigned long>(parserConfig.getMaxInflatedSize())}
+{
+    if (parserConfig.getCompact())
+        options |= XML_PARSE_COMPACT;
+    if (parserConfig.getNoNet())
+        options |= XML_PARSE_NONET;
+    if (parserConfig.getNoBlanks())
+        options |= XML_PARSE_NOBLANKS;
+    if (parserConfig.getHuge())
+        options |= XML_PARSE_HUGE;
+
+    context = xmlNewParserCtxt();
+    if (context == nullptr)
+        throw ParseXmlException("Failed to create parser context!!!\n");
+}
+
+ParserContext::~ParserContext()
+{
+    if (context)
+        xmlFreeParserCtxt(context);
+}
+
+/*
+ * Parses a document from memory.
+ *
+ * xmlCtxtReadMemory resets the context before parsing , but keeps its
+ * dictionary , so names seen in previous documents are found there.
+ */
+xmlDocPtr ParserContext::readMemory(const char *data, size_t size)
+{
+    xmlDocPtr doc = xmlCtxtReadMemory(context, data, size, nullptr, nullptr, options);
+    if (doc == nullptr)
+        throw ParseXmlException("Failed to parse XML document!!!\n");
+
+    return doc;
+}
+
+/*
+ * Parses a compressed document from memory.
+ *
+ * The context is reset for push parsing (its dictionary is kept) , then the data
+ * is inflated into a fixed size chunk that is pushed to the parser until the
+ * end of the compressed stream.
+ * Parsing stops at the first error of the parser , and when the inflated document
+ * grows above maxInflatedSize (a small body may inflate to gigabytes).
+ */
+xmlDocPtr ParserContext::readCompressed(const char *data, size_t size, Compression compression,
+                                        size_t &inflatedSize)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    /*15 -> zlib format , 16 + 15 -> gzip format*/
+    int windowBits = (compression == Compression::gzip) ? 16 + MAX_WBITS : MAX_WBITS;
+    if (inflateInit2(&stream, windowBits) != Z_OK)
+        throw ParseXmlException("Failed to initialize decompression!!!\n");
+
+    xmlCtxtResetPush(context, nullptr, 0, nullptr, nullptr);
+    xmlCtxtUseOptions(context, options);
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream.avail_in = size;
+
+    char chunk[inflateChunkSize];
+    int status = Z_OK;
+
+    while (status != Z_STREAM_END) {
+        stream.next_out = reinterpret_cast<Bytef *>(chunk);
+        stream.avail_out = sizeof(chunk);
+
+        /*A truncated stream ends with Z_BUF_ERROR*/
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            inflateEnd(&stream);
+            xmlCtxtReset(context);
+            throw ParseXmlException("Failed to decompress XML document!!!\n");
+        }
+
+        if (stream.total_out > maxInflatedSize) {
+            inflateEnd(&stream);
+            xmlCtxtReset(context);
+            throw ParseXmlException("Decompressed XML document is too large!!!\n");
+        }
+
+        int produced = sizeof(chunk) - stream.avail_out;
+        if (produced > 0 && xmlParseChunk(context, chunk, produced, 0) != 0)
+            break;
+    }
+    inflatedSize = stream.total_out;
+    inflateEnd(&stream);
+
+    /*Terminates the document , unless the parser already failed*/
+    int error = status == Z_STREAM_END ? xmlParseChunk(context, nullptr, 0, 1) : 1;
+
+    xmlDocPtr doc = context->myDoc;
+    context->myDoc = nullptr;
+
+    if (error != 0 || doc == nullptr || ! context->wellFormed) {
+        if (doc)
+            xmlFreeDoc(doc);
+        throw ParseXmlException("Failed to parse XML document!!!\n");
+    }
+
+    return doc;
+}
+
+/* Parses a plain or compressed document.*/
+xmlDocPtr ParserContext::read(const char *data, size_t size, Compression compression,
+                              size_t &documentSize)
+{
+    if (compression == Compression::none) {
+        documentSize = size;
+        return readMemory(data, size);
+    }
+
+    return readCompressed(data, size, compression, documentSize);
+}
+
+int ParserContext::getOptions() const
+{
+    return options;
+}
+
+} /*namespace XML*/
@@ -1,48 +1,121 @@
 #include "parser.hpp"
 
+#include "metrics.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
 namespace XML
 {
 
+/*
+ * @class WriterSink
+ * @brief passes the result of a select to the writer of a client.
+ * Chunks are queued without waiting , the database drains the writer when it
+ * released dbMutex.
+ */
+class WriterSink : public ResultSink
+{
+public:
+    explicit WriterSink(ResponseWriter &writer) : writer {writer}
+    {
+    }
+
+    bool write(const std::string &chunk) override
+    {
+        return writer.queue(chunk.data(), chunk.size());
+    }
+
+    bool isFull() const override
+    {
+        return writer.isFull();
+    }
+
+    bool drain() override
+    {
+        return writer.drain();
+    }
+
+private:
+    ResponseWriter &writer;
+};
+
 /**
  *
  * Implementation for "Parser" Class
  *
  */
 
+Parser::Parser(size_t planCacheSize) : plans {planCacheSize}
+{
+}
+
 /*
  * -Process XML data received from a client and either retrieves data from the database(for SELECT
  * queries)
  * -or stores the XML data into the database(for INSERT operation)
  * -handles exceptions related to XML parsing and database intractions.
  */
-void Parser::parseAndStoreXmlData(Client *client, DatabaseManager *database)
+void Parser::parseAndStoreXmlData(Client *client, DatabaseManager *database,
+                                  ParserContext *context)
 {
-    Tree *tree;
+    Tree *tree = nullptr;
     try {
-        std::string xmlData = client->getInputData();
+        const std::string &xmlData = client->getInputData();
+
+        /*Parses with the context of the calling worker*/
+        TraceSpan parseSpan {"parse"};
+        size_t documentSize = 0;
+        xmlDocPtr xmlDoc = context->read(xmlData.c_str(), xmlData.length(),
+                                         client->getCompression(), documentSize);
+        parseSpan.end();
 
-        /*Builds the tree*/
-        tree = new Tree {xmlData};
+        /*No tree is built if the shape of the document is known*/
+        TraceSpan collectSpan {"collect"};
+        DocumentRows document;
+        tree = collectDocument(xmlDoc, documentSize, document);
+        collectSpan.end();
 
-        if (tree->getIsSelectType()) {
-            if (! tree->getTableName().empty())
-                client->setResult(database->fetchTableDataAsXML(tree->getTableName()));
+        if (tree && (tree->getIsSelectType() || tree->getIsChangesType())) {
+            /*The result is streamed to the writer of the client*/
+            WriterSink sink {client->getWriter()};
+
+            OutputFormat format = outputFormat(tree->getFormat());
+
+            if (tree->getIsChangesType())
+                database->fetchChanges(tree->getWatermarks(), format, sink);
+            else if (! tree->getTableName().empty())
+                database->fetchTableData(tree->getTableName(), format, sink);
             else
-                client->setResult(database->fetchAllTablesAsXML());
+                database->fetchAllTables(format, sink);
+
+            client->setResult("");
 
             delete tree;
             tree = nullptr;
 
             client->getCV().notify_one();
-        } else {
-            Node *root = tree->getRoot();
+        } else if (tree && tree->getIsStatsType()) {
+            client->setResult(Metrics::instance().toXML());
 
-            const std::string uuid = tree->getUuid();
-            const std::string mainTable = tree->getMainTable();
+            delete tree;
+            tree = nullptr;
 
-            storeXmlNodesInDatabase(tree, root, uuid, mainTable, database);
+            client->getCV().notify_one();
+        } else if (tree && tree->getIsTraceType()) {
+            client->setResult(Tracer::instance().toChromeJSON());
 
-            client->setResult("done :) \n");
+            delete tree;
+            tree = nullptr;
+
+            client->getCV().notify_one();
+        } else {
+            /*A retried xml data that is already stored is acknowledged too*/
+            if (database->insertRows(document.uuid, document.mainTable, document.rows)) {
+                client->setResult("done :) \n");
+            } else {
+                Metrics::instance().counter("inserts.duplicates").add();
+                client->setResult("done :) already stored\n");
+            }
 
             delete tree;
             tree = nullptr;
@@ -67,63 +140,201 @@ void Parser::handleException(Client *client, const std::exception &e, Tree *tree
         tree = nullptr;
     }
     std::string message = "Error : " + std::string(e.what());
-    client->setResult(message);
+    client->setResult(std::move(message));
     client->getCV().notify_one();
 }
 
 /*
- * Stores XML nodes into a specified database by Non-recursively traversing the XML tree.
+ * Collects the rows of a parsed document.
  *
- * This method process each node in the XML tree ( of the Tree object ).
- * For each node:
- * 1.It checks if the node is Element node.
- * 2.If the node has property nodes,it collects their names and values.
- * 3.The method checks if a table exist in the database:
- * -If it exists ,it inserts the collected properties and their values into the database.
- * -If it does not exits ,it first create a new table then inserts the values.
+ * 1.The shape (names and nesting of elements) of the document is computed.
+ * 2.If a plan of this shape is cached , the values are read from the elements
+ * given by the plan , no tree is built and no node is classified.
+ * 3.Otherwise the tree is built and its rows are collected , the plan of an insert
+ * document is cached for the next document with the same shape.
  *
- * 4.The method recursively processes child nodes and sibling nodes to ensure all nodes in the
- * XML structure are stored in the database.
+ * The collected rows are passed to the database in document order and inserted
+ * in one transaction , a table that does not exist is created before its first row.
  */
+Tree *Parser::collectDocument(xmlDocPtr xmlDoc, size_t documentSize, DocumentRows &document)
+{
+    /*A disabled cache does not walk the document (an empty shape is not plannable)*/
+    DocumentShape shape {plans.getCapacity() > 0 ? xmlDoc : nullptr};
 
-void Parser::storeXmlNodesInDatabase(Tree *tree, Node *root, const std::string &uuid,
-                                     const std::string &mainTable, DatabaseManager *database)
+    if (shape.plannable) {
+        bool found = false;
+        try {
+            found = plans.extract(shape, document);
+        } catch (...) {
+            xmlFreeDoc(xmlDoc);
+            throw;
+        }
+
+        if (found) {
+            xmlFreeDoc(xmlDoc);
+            Metrics::instance().counter("plans.hits").add();
+            return nullptr;
+        }
+    }
+
+    /*The tree frees the document*/
+    Tree *tree = new Tree {xmlDoc, documentSize};
+    if (tree->getIsSelectType() || tree->getIsChangesType() || tree->getIsStatsType() ||
+        tree->getIsTraceType())
+        return tree;
+
+    try {
+        document.uuid = tree->getUuid();
+        document.mainTable = tree->getMainTable();
+        collectDocumentRows(tree, document.rows);
+
+        if (shape.plannable) {
+            plans.store(buildPlan(shape, tree), shape.hash);
+            Metrics::instance().counter("plans.misses").add();
+        }
+    } catch (...) {
+        delete tree;
+        throw;
+    }
+
+    return tree;
+}
+
+/*
+ * Creates the plan of an insert tree.
+ * Walks the tree like collectTableRows and keeps , for each row , the table , the
+ * names of properties and the indexes of the elements that hold the values.
+ */
+std::shared_ptr<InsertPlan> Parser::buildPlan(const DocumentShape &shape, Tree *tree)
 {
-    if (! root)
-        return;
+    std::unordered_map<xmlNodePtr, size_t> indexes;
+    for (size_t i = 0; i < shape.elements.size(); i++)
+        indexes[shape.elements[i]] = i;
+
+    std::shared_ptr<InsertPlan> plan = std::make_shared<InsertPlan>();
+    plan->skeleton = shape.skeleton;
+    plan->mainTable = tree->getMainTable();
+    plan->uuidElement = indexes.at(tree->find("uuid")->getXmlNode());
 
     std::stack<Node *> nodeStack;
-    nodeStack.push(root);
+    nodeStack.push(tree->getRoot());
 
     while (! nodeStack.empty()) {
         Node *node = nodeStack.top();
         nodeStack.pop();
 
         if (node->isElementNode() && node->hasPropertyNode()) {
-            std::string nodeName = node->getName();
+            RowPlan row;
+            row.tableName = node->getName();
 
-            std::vector<std::string> names = node->collectPropertyNames();
-            std::vector<std::string> values = node->collectPropertyValues();
-
-            if (database->isExistTable(node->getName())) {
-                database->insertIntoTable(uuid, names, values, nodeName);
-            } else {
-                bool isMainTable = (mainTable == nodeName);
-                database->createTable(nodeName, names, isMainTable, mainTable);
-
-                database->insertIntoTable(uuid, names, values, nodeName);
+            /*Same properties as collectPropertyNames and collectPropertyValues*/
+            for (Node *child : node->getChildren()) {
+                if (child->isPropertyNode() && child->isElementNode()) {
+                    if (child->getName() == "uuid")
+                        continue;
+                    row.names.push_back(child->getName());
+                    row.valueElements.push_back(indexes.at(child->getXmlNode()));
+                }
             }
-        }
 
-        Node *next = node->getNext();
-        if (next) {
-            nodeStack.push(next);
+            plan->rows.push_back(std::move(row));
         }
 
-        Node *child = node->getChild();
-        if (child) {
-            nodeStack.push(child);
-        }
+        std::vector<Node *> &children = node->getChildren();
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            nodeStack.push(*it);
+    }
+
+    return plan;
+}
+
+/* Maps the format attribute (checked by the tree) to the output format.*/
+OutputFormat Parser::outputFormat(const std::string &format)
+{
+    if (format == "json")
+        return OutputFormat::json;
+    if (format == "binary")
+        return OutputFormat::binary;
+
+    return OutputFormat::xml;
+}
+
+void Parser::setPlanCacheSize(size_t planCacheSize)
+{
+    plans.setCapacity(planCacheSize);
+}
+
+/*
+ * Collects the rows of all nodes of tree in document order.
+ *
+ * For large trees the work is split below the first node with more than one
+ * child (like Tree::buildTree) : the chain above it is collected first , its
+ * children on several threads , each thread keeps the rows of its subtree and the
+ * rows are merged in the order of the subtrees , so the result is the same as a
+ * single thread.
+ */
+void Parser::collectDocumentRows(Tree *tree, std::vector<TableRow> &rows)
+{
+    Node *root = tree->getRoot();
+    if (! root)
+        return;
+
+    if (tree->getNodeCount() < parallelStoreThreshold) {
+        collectTableRows(root, rows);
+        return;
+    }
+
+    /*The chain of single children (root , main table) is collected first*/
+    Node *splitNode = root;
+    collectNodeRow(splitNode, rows);
+
+    while (splitNode->getChildren().size() == 1) {
+        splitNode = splitNode->getChildren().front();
+        collectNodeRow(splitNode, rows);
+    }
+
+    std::vector<Node *> &subtrees = splitNode->getChildren();
+    std::vector<std::vector<TableRow>> subtreeRows(subtrees.size());
+
+    parallelFor(subtrees.size(), [&subtrees, &subtreeRows, this](size_t i) {
+        collectTableRows(subtrees[i], subtreeRows[i]);
+    });
+
+    for (std::vector<TableRow> &part : subtreeRows) {
+        rows.insert(rows.end(), std::make_move_iterator(part.begin()),
+                    std::make_move_iterator(part.end()));
+    }
+}
+
+/* Non-Recursively collects rows of the subtree below root in document order.*/
+void Parser::collectTableRows(Node *root, std::vector<TableRow> &rows)
+{
+    std::stack<Node *> nodeStack;
+    nodeStack.push(root);
+
+    while (! nodeStack.empty()) {
+        Node *node = nodeStack.top();
+        nodeStack.pop();
+
+        collectNodeRow(node, rows);
+
+        /*Children are pushed in reverse order so the first child is processed first*/
+        std::vector<Node *> &children = node->getChildren();
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            nodeStack.push(*it);
+    }
+}
+
+/* Adds the row of node if it is a table (an element node with property nodes).*/
+void Parser::collectNodeRow(Node *node, std::vector<TableRow> &rows)
+{
+    if (node->isElementNode() && node->hasPropertyNode()) {
+        TableRow row;
+        row.tableName = node->getName();
+        row.names = node->collectPropertyNames();
+        row.values = node->collectPropertyValues();
+
+        rows.push_back(std::move(row));
     }
 }
 /* Stores XML nodes into a specified database by Non-recursively traversing the XML tree.*/
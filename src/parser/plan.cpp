@@ -0,0 +1,164 @@
+#include "plan.hpp"
+
+#include "tree.hpp"
+
+/*FNV-1a 64 bit parameters*/
+const uint64_t fnvOffsetBasis = 14695981039346656037ULL;
+const uint64_t fnvPrime = 1099511628211ULL;
+
+namespace XML
+{
+
+/**
+ *
+ * Implementation for "DocumentShape" struct
+ *
+ */
+
+/*
+ * Non-Recursively walks the elements in document order , the walk goes down to
+ * the first child element , then to the next sibling , and up to the parent when
+ * an element has no more siblings. Text nodes are not part of the shape.
+ */
+DocumentShape::DocumentShape(xmlDocPtr doc) : hash {fnvOffsetBasis}, plannable {false}
+{
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    if (! root)
+        return;
+
+    /*Requests (select , stats , ...) are not inserts*/
+    for (xmlNodePtr child = xmlFirstElementChild(root); child;
+         child = xmlNextElementSibling(child)) {
+        if (xmlStrEqual(child->name, BAD_CAST "operation"))
+            return;
+    }
+
+    xmlNodePtr current = root;
+    while (current) {
+        if (elements.size() == planMaxElements)
+            return;
+
+        elements.push_back(current);
+        skeleton += reinterpret_cast<const char *>(current->name);
+
+        xmlNodePtr child = xmlFirstElementChild(current);
+        if (child) {
+            skeleton += '<';
+            current = child;
+            continue;
+        }
+
+        /*Goes up until an element with a next sibling is found*/
+        xmlNodePtr next = nullptr;
+        while (current != root) {
+            next = xmlNextElementSibling(current);
+            if (next) {
+                skeleton += ',';
+                break;
+            }
+            skeleton += '>';
+            current = current->parent;
+        }
+        current = next;
+    }
+
+    for (char c : skeleton) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= fnvPrime;
+    }
+
+    plannable = true;
+}
+
+/**
+ *
+ * Implementation for "PlanCache" class
+ *
+ */
+
+PlanCache::PlanCache(size_t capacity) : capacity {capacity}
+{
+}
+
+/*
+ * Fills document with the rows of the cached plan of shape.
+ * The skeleton is compared , so a hash collision is a miss and not wrong rows.
+ */
+bool PlanCache::extract(const DocumentShape &shape, SQLite::DocumentRows &document)
+{
+    std::shared_ptr<InsertPlan> plan;
+    {
+        std::lock_guard<std::mutex> lock(cacheMtx);
+
+        auto it = plans.find(shape.hash);
+        if (it == plans.end() || it->second->skeleton != shape.skeleton)
+            return false;
+
+        plan = it->second;
+    }
+
+    document.uuid = elementContent(shape.elements[plan->uuidElement]);
+    if (document.uuid.empty())
+        throw ParseXmlException("Uuid not found!!!\n");
+
+    document.mainTable = plan->mainTable;
+
+    document.rows.reserve(plan->rows.size());
+    for (const RowPlan &rowPlan : plan->rows) {
+        SQLite::TableRow row;
+        row.tableName = rowPlan.tableName;
+        row.names = rowPlan.names;
+
+        row.values.reserve(rowPlan.valueElements.size());
+        for (size_t element : rowPlan.valueElements)
+            row.values.push_back(elementContent(shape.elements[element]));
+
+        document.rows.push_back(std::move(row));
+    }
+
+    return true;
+}
+
+/* Adds a plan , a full cache drops one plan first.*/
+void PlanCache::store(std::shared_ptr<InsertPlan> plan, uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(cacheMtx);
+    if (capacity == 0)
+        return;
+
+    if (plans.size() >= capacity && plans.find(hash) == plans.end())
+        plans.erase(plans.begin());
+
+    plans[hash] = std::move(plan);
+}
+
+/* Changes the capacity , plans above the new capacity are dropped.*/
+void PlanCache::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(cacheMtx);
+    this->capacity = capacity;
+
+    while (plans.size() > capacity)
+        plans.erase(plans.begin());
+}
+
+size_t PlanCache::getCapacity()
+{
+    std::lock_guard<std::mutex> lock(cacheMtx);
+    return capacity;
+}
+
+/* Returns the text content of element (same as Node::getContent).*/
+std::string PlanCache::elementContent(xmlNodePtr element)
+{
+    xmlChar *content = xmlNodeGetContent(element);
+    if (! content)
+        return std::string();
+
+    std::string result = reinterpret_cast<const char *>(content);
+    xmlFree(content);
+
+    return result;
+}
+
+} /*namespace XML*/
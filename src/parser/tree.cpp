@@ -1,4 +1,11 @@
 #include "tree.hpp"
+
+#include "context.hpp"
+#include "parallel.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+
 namespace XML
 {
 
@@ -53,7 +60,14 @@ std::string Node::xmlCharToString(const xmlChar *xml)
 /* Returns the content of the current node */
 std::string Node::getContent() 
 {
-    return xmlCharToString(xmlNodeGetContent(xmlNode));
+    xmlChar *content = xmlNodeGetContent(xmlNode);
+    if (! content)
+        return std::string();
+
+    std::string result = xmlCharToString(content);
+    xmlFree(content);
+
+    return result;
 }
 
 /* Returns the name of the current node */
@@ -140,10 +154,46 @@ Node *Node::getParent() const
  *
  */
 
-Tree::Tree(std::string &xmlData)
+Tree::Tree(const std::string &xmlData, ParserContext *context) :
+    Tree(xmlData.c_str(), xmlData.length(), context)
 {
-    this->xmlData = xmlData;
-    initialize();
+}
+Tree::Tree(const char *xmlData, size_t xmlDataSize, ParserContext *context,
+           Compression compression) :
+    xmlDoc {nullptr},
+    root {nullptr},
+    xmlData {xmlData},
+    xmlDataSize {xmlDataSize},
+    context {context},
+    compression {compression},
+    documentSize {xmlDataSize}
+{
+    try {
+        initialize();
+    } catch (...) {
+        /*The destructor is not called when the constructor throws*/
+        freeTree();
+        if (xmlDoc)
+            xmlFreeDoc(xmlDoc);
+        throw;
+    }
+}
+Tree::Tree(xmlDocPtr xmlDoc, size_t documentSize) :
+    xmlDoc {xmlDoc},
+    root {nullptr},
+    xmlData {nullptr},
+    xmlDataSize {0},
+    context {nullptr},
+    compression {Compression::none},
+    documentSize {documentSize}
+{
+    try {
+        initialize();
+    } catch (...) {
+        freeTree();
+        xmlFreeDoc(this->xmlDoc);
+        throw;
+    }
 }
 Tree::~Tree()
 {
@@ -161,9 +211,9 @@ Tree::~Tree()
  */
 void Tree::initialize()
 {
-    xmlDoc = xmlReadMemory(xmlData.c_str(), xmlData.length(), nullptr, nullptr, 0);
-    if (xmlDoc == nullptr)
-        throw ParseXmlException("Failed to parse XML document!!!\n");
+    /*Parses with the reused context , the context throws if the document is invalid*/
+    if (! xmlDoc)
+        xmlDoc = context->read(xmlData, xmlDataSize, compression, documentSize);
 
     /*Builds tree*/
     root = buildTree(xmlDocGetRootElement(xmlDoc));
@@ -171,7 +221,7 @@ void Tree::initialize()
     /*Determines xmldata type*/
     determineType();
 
-    if (! isSelectType) {
+    if (! isSelectType && ! isChangesType && ! isStatsType && ! isTraceType) {
         /*Finds UUID node*/
         Node *uuidNode = find("uuid");
 
@@ -204,6 +254,12 @@ void Tree::initialize()
  * - Processes each XML element node and its children in depth-first order.
  * - Maintains parent-child relationships and sets sibling links using the `next` pointer.
  * - Tracks all created Node objects in the `allNodes` list.
+ * - For large documents the work is split below the first node with more
+ *   than one child (an insert is <root><mainTable>..</mainTable></root> , so
+ *   that is usually the main table). Its children are built on several
+ *   threads, each thread keeps its nodes in its own list and the lists are
+ *   merged into `allNodes` at the end (also when a thread failed , so
+ *   freeTree deletes them).
  *
  * Parameters:
  * - xmlNode: A pointer to the current XML node being processed.
@@ -217,41 +273,84 @@ Node *Tree::buildTree(xmlNodePtr xmlNode)
     if (! xmlNode)
         return nullptr;
 
-    /*Create a stack to hold pairs of xmlNodePtr and Node*/
-    std::stack<std::pair<xmlNodePtr, Node *>> nodeStack;
     Node *root = new Node(xmlNode);
     allNodes.push_back(root);
-    nodeStack.push({xmlNode, root});
+
+    if (documentSize < parallelBuildThreshold) {
+        buildSubtree(root, allNodes);
+        return root;
+    }
+
+    /*A chain of single children (root , main table) is created here*/
+    Node *splitNode = root;
+    addChildren(splitNode, allNodes);
+
+    while (splitNode->getChildren().size() == 1) {
+        splitNode = splitNode->getChildren().front();
+        addChildren(splitNode, allNodes);
+    }
+
+    std::vector<Node *> &subtrees = splitNode->getChildren();
+    std::vector<std::vector<Node *>> workerNodes(subtrees.size());
+
+    auto mergeNodes = [&workerNodes, this]() {
+        for (std::vector<Node *> &nodes : workerNodes)
+            allNodes.insert(allNodes.end(), nodes.begin(), nodes.end());
+    };
+
+    try {
+        parallelFor(subtrees.size(), [&subtrees, &workerNodes, this](size_t i) {
+            buildSubtree(subtrees[i], workerNodes[i]);
+        });
+    } catch (...) {
+        mergeNodes();
+        throw;
+    }
+    mergeNodes();
+
+    return root;
+}
+
+/* Non-Recursively builds the subtree below root and stores created nodes in nodes*/
+void Tree::buildSubtree(Node *root, std::vector<Node *> &nodes)
+{
+    /*Create a stack to hold nodes whose children are not built yet*/
+    std::stack<Node *> nodeStack;
+    nodeStack.push(root);
 
     /*While there are still nodes to process in the stack*/
     while (! nodeStack.empty()) {
-        std::pair<xmlNodePtr, Node *> nodeInfo = nodeStack.top();
-        xmlNodePtr currentXmlNode = nodeInfo.first;
-        Node *currentNode = nodeInfo.second;
+        Node *currentNode = nodeStack.top();
         nodeStack.pop();
 
-        Node *lastChild = nullptr;
+        addChildren(currentNode, nodes);
 
-        /*Iterate through the children of the current XML node*/
-        for (xmlNodePtr cur = currentXmlNode->children; cur; cur = cur->next) {
-            if (cur->type == XML_ELEMENT_NODE) {
-                Node *child = new Node(cur);
-                allNodes.push_back(child);
-                child->setParent(currentNode);
-                currentNode->addChild(child);
+        /*Push the newly created children onto the stack*/
+        for (Node *child : currentNode->getChildren())
+            nodeStack.push(child);
+    }
+}
 
-                /*Set the next pointer of the last child if it exists*/
-                if (lastChild) {
-                    lastChild->setNext(child);
-                }
-                lastChild = child;
+/* Creates the element children of node and links them as siblings*/
+void Tree::addChildren(Node *node, std::vector<Node *> &nodes)
+{
+    Node *lastChild = nullptr;
 
-                /*Push the current xmlNode and the newly created child Node onto the stack*/
-                nodeStack.push({cur, child});
+    /*Iterate through the children of the XML node*/
+    for (xmlNodePtr cur = node->getXmlNode()->children; cur; cur = cur->next) {
+        if (cur->type == XML_ELEMENT_NODE) {
+            Node *child = new Node(cur);
+            nodes.push_back(child);
+            child->setParent(node);
+            node->addChild(child);
+
+            /*Set the next pointer of the last child if it exists*/
+            if (lastChild) {
+                lastChild->setNext(child);
             }
+            lastChild = child;
         }
     }
-    return root;
 }
 
 /*Recursively builds a tree structure from an XML node.*/
@@ -279,11 +378,14 @@ Node *Tree::buildTree(xmlNodePtr xmlNode)
 }*/
 
 /*
- *Determines the type of the XML operation(select or insert).
- *Updates the isSelectType.
+ *Determines the type of the XML operation(select , changes , stats , trace or insert).
+ *Updates the isSelectType , isChangesType , isStatsType , isTraceType , format and
+ *watermarks (every <table after="rowid">name</table> of a changes operation).
  *
  *Throws an exception if :
  *-type attribute is nall.
+ *-format attribute is not xml , json or binary.
+ *-after attribute is not a rowid (a number , 0 or more).
  */
 void Tree::determineType()
 {
@@ -299,11 +401,24 @@ void Tree::determineType()
             } else
                 throw ParseXmlException("type attribute is null in <operation> element\n");
 
+            xmlChar *formatAttribute = xmlGetProp(node->getXmlNode(), BAD_CAST "format");
+            if (formatAttribute != nullptr) {
+                format = reinterpret_cast<const char *>(formatAttribute);
+                xmlFree(formatAttribute);
+
+                if (format != "xml" && format != "json" && format != "binary")
+                    throw ParseXmlException("Unknown format : " + format + "\n");
+            }
+
             for (Node *childNode : node->getChildren()) {
                 if (childNode->isElementNode() &&
                     strcmp(childNode->getName().c_str(), "table") == 0) {
-                    tableName = childNode->getContent();
-                    break;
+                    if (tableName.empty())
+                        tableName = childNode->getContent();
+
+                    if (operationType == "changes")
+                        watermarks.emplace_back(childNode->getContent(),
+                                                readWatermark(childNode));
                 }
             }
 
@@ -311,6 +426,10 @@ void Tree::determineType()
         }
     }
 
+    isStatsType = strcmp(operationType.c_str(), "stats") == 0;
+    isTraceType = strcmp(operationType.c_str(), "trace") == 0;
+    isChangesType = strcmp(operationType.c_str(), "changes") == 0;
+
     if (strcmp(operationType.c_str(), "select") == 0) {
         isSelectType = true;
         this->tableName = tableName;
@@ -318,6 +437,26 @@ void Tree::determineType()
         isSelectType = false;
 }
 
+/* Returns the after attribute of a <table> element , 0 if it has none.*/
+long long Tree::readWatermark(Node *tableNode)
+{
+    xmlChar *afterAttribute = xmlGetProp(tableNode->getXmlNode(), BAD_CAST "after");
+    if (afterAttribute == nullptr)
+        return 0;
+
+    std::string after = reinterpret_cast<const char *>(afterAttribute);
+    xmlFree(afterAttribute);
+
+    char *end = nullptr;
+    errno = 0;
+    long long rowid = strtoll(after.c_str(), &end, 10);
+
+    if (after.empty() || *end != '\0' || errno == ERANGE || rowid < 0)
+        throw ParseXmlException("Invalid after attribute : " + after + "\n");
+
+    return rowid;
+}
+
 /*Pass name and root to the findNode method*/
 Node *Tree::find(const std::string &name)
 {
@@ -389,6 +528,22 @@ bool Tree::getIsSelectType() const
 {
     return isSelectType;
 }
+bool Tree::getIsStatsType() const
+{
+    return isStatsType;
+}
+bool Tree::getIsTraceType() const
+{
+    return isTraceType;
+}
+bool Tree::getIsChangesType() const
+{
+    return isChangesType;
+}
+const std::vector<std::pair<std::string, long long>> &Tree::getWatermarks() const
+{
+    return watermarks;
+}
 const std::string &Tree::getUuid() const
 {
     return uuid;
@@ -405,5 +560,13 @@ const std::string &Tree::getTableName() const
 {
     return tableName;
 }
+const std::string &Tree::getFormat() const
+{
+    return format;
+}
+size_t Tree::getNodeCount() const
+{
+    return allNodes.size();
+}
 
 } /*namespace XML*/
@@ -0,0 +1,81 @@
+/**
+ *
+ * \file : main.cpp
+ *
+ * dbm-replay : replays a capture file of dbm against a running server.
+ *
+ * \author : MohammadDerhami
+ */
+
+#include "replay.hpp"
+
+#include <iostream>
+#include <unistd.h>
+
+/*Prints the help message for command-line usage.*/
+static void printHelp()
+{
+    std::cout << "Usage:\n"
+                 "  ./dbm-replay -c <capture file> [-a <ip>] [-p <port>] [-u <unix path>] "
+                 "[-s <speed>]\n\n"
+                 "  -c : capture file written by dbm (capturePath in config.json).\n"
+                 "  -a : ip of the server , by default 127.0.0.1.\n"
+                 "  -p : port of the server , by default 8080.\n"
+                 "  -u : connect to the AF_UNIX socket of the server instead of ip and port.\n"
+                 "  -s : speed , 1 -> original timing (default) , 2 -> twice as fast ,\n"
+                 "       0 -> as fast as the server answers.\n"
+                 "  -h : Display this help message.\n";
+}
+
+int main(int argc, char *argv[])
+{
+    ReplayOptions options;
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, ":c:a:p:u:s:h")) != -1) {
+            switch (opt) {
+            case 'c':
+                options.capturePath = optarg;
+                break;
+            case 'a':
+                options.ip = optarg;
+                break;
+            case 'p':
+                options.port = std::stoi(optarg);
+                break;
+            case 'u':
+                options.unixPath = optarg;
+                break;
+            case 's':
+                options.speed = std::stod(optarg);
+                break;
+            case 'h':
+                printHelp();
+                return 0;
+            case ':':
+                std::cout << "Error : Option needs a value \n\n";
+                printHelp();
+                return 1;
+            case '?':
+                std::cout << "UnKnown option \n";
+                printHelp();
+                return 1;
+            }
+        }
+
+        if (options.capturePath.empty() || options.speed < 0) {
+            printHelp();
+            return 1;
+        }
+
+        Replayer replayer {options};
+        replayer.run();
+
+    } catch (const std::exception &e) {
+        std::cerr << "Error : " << e.what();
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,314 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+/*Prompts and messages of the server protocol*/
+const std::string lengthPrompt = "15 digits : \n";
+const std::string dataPrompt = " : \n";
+const std::string continuePrompt = "\nPress 'y' if you want to continue .\n";
+const std::string busyMessage = "Server busy : request rejected , try again later.\n";
+
+/*Seconds a connection waits for the server before the request is failed*/
+const int replayReceiveTimeout = 120;
+
+/* Reads what the server sent into input , false if the connection is closed.*/
+static bool receiveMore(int socket, std::string &input)
+{
+    char buffer[65536];
+
+    ssize_t bytesRead = recv(socket, buffer, sizeof(buffer), 0);
+    if (bytesRead <= 0)
+        return false;
+
+    input.append(buffer, bytesRead);
+    return true;
+}
+
+/* Reads until input contains token , removes input up to the end of token.*/
+static bool skipPast(int socket, std::string &input, const std::string &token)
+{
+    size_t position;
+    while ((position = input.find(token)) == std::string::npos) {
+        if (! receiveMore(socket, input))
+            return false;
+    }
+
+    input.erase(0, position + token.size());
+    return true;
+}
+
+static bool sendAll(int socket, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t bytesSent = send(socket, data, size, MSG_NOSIGNAL);
+        if (bytesSent <= 0)
+            return false;
+
+        data += bytesSent;
+        size -= bytesSent;
+    }
+    return true;
+}
+
+/**
+ *
+ * Implementation for "Replayer" class
+ *
+ */
+
+/*
+ * Requests are grouped by session and connection , since connection ids restart with
+ * every server run. Each session continues where the previous one ended , so the time
+ * the server was down is not replayed.
+ */
+Replayer::Replayer(const ReplayOptions &options) :
+    options {options},
+    requestCount {0},
+    sessionCount {0},
+    stored {0},
+    duplicates {0},
+    errors {0},
+    rejected {0},
+    others {0},
+    failed {0}
+{
+    CaptureReader reader {options.capturePath};
+
+    CaptureRecord record;
+    uint64_t sessionFirst = 0;
+    uint64_t sessionBase = 0;
+    uint64_t last = 0;
+
+    while (reader.next(record)) {
+        if (record.isSessionStart() || sessionCount == 0) {
+            sessionFirst = record.timestamp;
+            sessionBase = last;
+            sessionCount++;
+        }
+
+        if (record.isSessionStart())
+            continue;
+
+        Request request;
+        request.offset = sessionBase +
+                         (record.timestamp > sessionFirst ? record.timestamp - sessionFirst : 0);
+        request.compression = record.compression;
+        request.body = std::move(record.body);
+
+        last = std::max(last, request.offset);
+        connections[std::make_pair(sessionCount, record.connection)].push_back(
+            std::move(request));
+        requestCount++;
+    }
+}
+
+void Replayer::run()
+{
+    std::cout << "Replaying " << requestCount << " requests on " << connections.size()
+              << " connections of " << sessionCount << " sessions ";
+    if (options.speed > 0)
+        std::cout << "at " << options.speed << "x speed.\n";
+    else
+        std::cout << "at maximum speed.\n";
+
+    start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (const auto &connection : connections)
+        threads.emplace_back(&Replayer::replayConnection, this, std::cref(connection.second));
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printReport(elapsed.count());
+}
+
+/*
+ * A connection closed by the server (timeout , drain) is opened again for the
+ * next request , the request that was being sent is counted as failed.
+ */
+void Replayer::replayConnection(const std::vector<Request> &requests)
+{
+    int socket = -1;
+    std::string input;
+    std::string answer;
+
+    for (const Request &request : requests) {
+        if (options.speed > 0) {
+            auto offset = std::chrono::microseconds(
+                static_cast<long long>(request.offset / options.speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+
+        if (socket < 0) {
+            input.clear();
+            socket = connectToServer();
+
+            if (socket < 0) {
+                failed++;
+                continue;
+            }
+        }
+
+        if (! sendRequest(socket, input, request, answer)) {
+            failed++;
+            close(socket);
+            socket = -1;
+            continue;
+        }
+
+        countAnswer(answer);
+    }
+
+    if (socket >= 0)
+        close(socket);
+}
+
+/*
+ * Sends the 15 digits of size with the compression flag , then the body , and reads
+ * the answer up to the continue prompt , which is answered with 'y'.
+ * A rejected request has no continue prompt , the server asks for the next size.
+ */
+bool Replayer::sendRequest(int socket, std::string &input, const Request &request,
+                           std::string &answer)
+{
+    if (! skipPast(socket, input, lengthPrompt))
+        return false;
+
+    char header[32];
+    int headerSize = snprintf(header, sizeof(header), "%015zu", request.body.size());
+    if (request.compression == XML::Compression::gzip)
+        header[headerSize++] = 'g';
+    else if (request.compression == XML::Compression::deflate)
+        header[headerSize++] = 'd';
+    header[headerSize++] = '\n';
+
+    auto sent = std::chrono::steady_clock::now();
+
+    if (! sendAll(socket, header, headerSize) || ! skipPast(socket, input, dataPrompt) ||
+        ! sendAll(socket, request.body.data(), request.body.size()))
+        return false;
+
+    size_t answerEnd;
+    while (true) {
+        if ((answerEnd = input.find(continuePrompt)) != std::string::npos) {
+            answer.assign(input, 0, answerEnd);
+            input.erase(0, answerEnd + continuePrompt.size());
+            break;
+        }
+        if ((answerEnd = input.find(busyMessage)) != std::string::npos) {
+            answer = busyMessage;
+            input.erase(0, answerEnd + busyMessage.size());
+            break;
+        }
+        if (! receiveMore(socket, input))
+            return false;
+    }
+
+    long long latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - sent)
+                            .count();
+    {
+        std::lock_guard<std::mutex> lock(latencyMtx);
+        latencies.push_back(latency);
+    }
+
+    if (answer != busyMessage && ! sendAll(socket, "y\n", 2))
+        return false;
+
+    return true;
+}
+
+void Replayer::countAnswer(const std::string &answer)
+{
+    if (answer.compare(0, 7, "done :)") == 0) {
+        if (answer.find("already stored") != std::string::npos)
+            duplicates++;
+        else
+            stored++;
+
+    } else if (answer.compare(0, 5, "Error") == 0)
+        errors++;
+
+    else if (answer == busyMessage)
+        rejected++;
+
+    else
+        others++;
+}
+
+int Replayer::connectToServer()
+{
+    int socket = -1;
+
+    if (! options.unixPath.empty()) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, options.unixPath.c_str(), sizeof(address.sun_path) - 1);
+
+        socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket >= 0 && connect(socket, (sockaddr *) &address, sizeof(address)) < 0) {
+            close(socket);
+            socket = -1;
+        }
+    } else {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+
+        if (inet_pton(AF_INET, options.ip.c_str(), &address.sin_addr) <= 0)
+            return -1;
+
+        socket = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (socket >= 0 && connect(socket, (sockaddr *) &address, sizeof(address)) < 0) {
+            close(socket);
+            socket = -1;
+        }
+    }
+
+    if (socket >= 0) {
+        timeval timeout {replayReceiveTimeout, 0};
+        setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    return socket;
+}
+
+/* Latencies are printed in milliseconds at the 50th , 90th and 99th percentiles.*/
+void Replayer::printReport(double seconds)
+{
+    long long answered = stored + duplicates + errors + rejected + others;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Replayed " << answered << " requests in " << seconds << " s ("
+              << (seconds > 0 ? answered / seconds : 0) << " requests/s).\n";
+    std::cout << "stored " << stored << " , already stored " << duplicates << " , errors "
+              << errors << " , rejected " << rejected << " , other answers " << others
+              << " , failed " << failed << "\n";
+
+    std::lock_guard<std::mutex> lock(latencyMtx);
+    if (latencies.empty())
+        return;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [this](double fraction) {
+        size_t index = static_cast<size_t>(fraction * (latencies.size() - 1));
+        return latencies[index] / 1000.0;
+    };
+
+    std::cout << "latency ms : p50 " << percentile(0.50) << " , p90 " << percentile(0.90)
+              << " , p99 " << percentile(0.99) << " , max " << latencies.back() / 1000.0 << "\n";
+}
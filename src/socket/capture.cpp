@@ -0,0 +1,242 @@
+#include "capture.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+/*Magic and version at the start of a capture file*/
+const char captureMagic[4] = {'D', 'B', 'M', 'C'};
+const unsigned char captureVersion = 1;
+
+/*Bytes of a record before its body : timestamp , connection , compression and size*/
+const long captureRecordHeaderSize = 8 + 4 + 1 + 4;
+
+/*Buffer of the capture file , records are written in large blocks*/
+const size_t captureBufferSize = 1 << 20;
+
+/* Appends value to data as bytes little endian.*/
+template <typename Value>
+static void putLittleEndian(std::string &data, Value value)
+{
+    for (size_t i = 0; i < sizeof(Value); i++)
+        data.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+/* Reads a little endian number of sizeof(Value) bytes , false at the end of file.*/
+template <typename Value>
+static bool getLittleEndian(FILE *file, Value &value)
+{
+    unsigned char bytes[sizeof(Value)];
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes))
+        return false;
+
+    value = 0;
+    for (size_t i = 0; i < sizeof(Value); i++)
+        value |= static_cast<Value>(bytes[i]) << (8 * i);
+
+    return true;
+}
+
+/**
+ *
+ * Implementation for "CaptureWriter" class
+ *
+ */
+
+CaptureWriter::CaptureWriter() : recording {false}, file {nullptr}
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    std::lock_guard<std::mutex> lock(captureMtx);
+    closeLocked();
+}
+
+/*
+ * A new or empty file gets the header , an existing capture is continued if it starts
+ * with the header of this version (records are only appended , a+ mode).
+ * Every call starts a session , so the requests of different server runs are kept
+ * apart by dbm-replay.
+ */
+void CaptureWriter::setPath(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(captureMtx);
+    if (path == this->path && (file || path.empty()))
+        return;
+
+    closeLocked();
+    this->path = path;
+
+    if (path.empty())
+        return;
+
+    file = fopen(path.c_str(), "a+b");
+    if (! file)
+        throw std::runtime_error("Failed to open capture file : " + path + "\n");
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+
+    if (size == 0) {
+        fwrite(captureMagic, 1, sizeof(captureMagic), file);
+        fputc(captureVersion, file);
+    } else
+        repairLocked(size);
+
+    /*The buffer is set after the reads of repairLocked*/
+    setvbuf(file, nullptr, _IOFBF, captureBufferSize);
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    writeLocked(std::chrono::duration_cast<std::chrono::microseconds>(now).count(),
+                captureSessionConnection, XML::Compression::none, nullptr, 0);
+    recording = true;
+}
+
+/*
+ * Walks the record headers from the start , the end of the last whole record is kept.
+ * Records are written in order , so after a crash only the last one can be cut.
+ */
+void CaptureWriter::repairLocked(long size)
+{
+    char magic[sizeof(captureMagic)];
+    fseek(file, 0, SEEK_SET);
+
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        memcmp(magic, captureMagic, sizeof(magic)) != 0 || fgetc(file) != captureVersion) {
+        closeLocked();
+        throw std::runtime_error("Not a capture file of version " +
+                                 std::to_string(captureVersion) + " : " + path + "\n");
+    }
+
+    long end = sizeof(captureMagic) + 1;
+    while (end + captureRecordHeaderSize <= size) {
+        uint32_t bodySize = 0;
+        if (fseek(file, end + captureRecordHeaderSize - 4, SEEK_SET) != 0 ||
+            ! getLittleEndian(file, bodySize) ||
+            end + captureRecordHeaderSize + static_cast<long>(bodySize) > size)
+            break;
+
+        end += captureRecordHeaderSize + bodySize;
+    }
+
+    if (end < size) {
+        if (ftruncate(fileno(file), end) != 0) {
+            closeLocked();
+            throw std::runtime_error("Failed to truncate capture file : " + path + "\n");
+        }
+        std::cerr << "Capture : removed " << size - end << " bytes of a cut record from "
+                  << path << ".\n";
+    }
+    fseek(file, 0, SEEK_END);
+}
+
+void CaptureWriter::record(uint32_t connection, XML::Compression compression, const char *body,
+                           size_t size)
+{
+    if (! recording)
+        return;
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    recordAt(std::chrono::duration_cast<std::chrono::microseconds>(now).count(), connection,
+             compression, body, size);
+}
+
+void CaptureWriter::recordAt(uint64_t timestamp, uint32_t connection,
+                             XML::Compression compression, const char *body, size_t size)
+{
+    std::lock_guard<std::mutex> lock(captureMtx);
+    if (file)
+        writeLocked(timestamp, connection, compression, body, size);
+}
+
+/* The header is built in memory first , so a record is written with two calls.*/
+void CaptureWriter::writeLocked(uint64_t timestamp, uint32_t connection,
+                                XML::Compression compression, const char *body, size_t size)
+{
+    std::string header;
+    putLittleEndian(header, timestamp);
+    putLittleEndian(header, connection);
+    header.push_back(static_cast<char>(compression));
+    putLittleEndian(header, static_cast<uint32_t>(size));
+
+    fwrite(header.data(), 1, header.size(), file);
+    if (size > 0)
+        fwrite(body, 1, size, file);
+}
+
+void CaptureWriter::flush()
+{
+    std::lock_guard<std::mutex> lock(captureMtx);
+    if (file)
+        fflush(file);
+}
+
+bool CaptureWriter::isRecording()
+{
+    return recording;
+}
+
+std::string CaptureWriter::getPath()
+{
+    std::lock_guard<std::mutex> lock(captureMtx);
+    return path;
+}
+
+void CaptureWriter::closeLocked()
+{
+    recording = false;
+
+    if (file)
+        fclose(file);
+
+    file = nullptr;
+}
+
+/**
+ *
+ * Implementation for "CaptureReader" class
+ *
+ */
+
+CaptureReader::CaptureReader(const std::string &path) : file {fopen(path.c_str(), "rb")}
+{
+    if (! file)
+        throw std::runtime_error("Failed to open capture file : " + path + "\n");
+
+    char magic[sizeof(captureMagic)];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        memcmp(magic, captureMagic, sizeof(magic)) != 0 || fgetc(file) != captureVersion) {
+        fclose(file);
+        throw std::runtime_error("Not a capture file : " + path + "\n");
+    }
+}
+
+CaptureReader::~CaptureReader()
+{
+    fclose(file);
+}
+
+bool CaptureReader::next(CaptureRecord &record)
+{
+    if (! getLittleEndian(file, record.timestamp))
+        return false;
+
+    uint32_t size = 0;
+    int compression = EOF;
+    if (! getLittleEndian(file, record.connection) || (compression = fgetc(file)) == EOF ||
+        ! getLittleEndian(file, size))
+        throw std::runtime_error("Truncated capture record\n");
+
+    if (compression > static_cast<int>(XML::Compression::gzip))
+        throw std::runtime_error("Invalid compression in capture record\n");
+
+    record.compression = static_cast<XML::Compression>(compression);
+
+    record.body.resize(size);
+    if (size > 0 && fread(&record.body[0], 1, size, file) != size)
+        throw std::runtime_error("Truncated capture record\n");
+
+    return true;
+}
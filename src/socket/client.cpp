@@ -1,5 +1,8 @@
 #include "client.hpp"
 
+/*Buffers above this capacity are released when a client is recycled*/
+const size_t clientBufferKeep = 1 << 20;
+
 /**
  *
  * Implementation for "Client" class
@@ -8,29 +11,54 @@
 
 Client::Client(int socket, int id) :
     clientSocket {socket},
+    compression {XML::Compression::none},
     id {id},
     resultReady {false},
-    dataReady {false}
+    dataReady {false},
+    disconnected {false},
+    withDeadline {false},
+    traceId {0}
 {
 }
 Client::~Client()
 {
     if (clientThread.joinable())
         clientThread.join();
-    if (parseThread.joinable())
-        parseThread.join();
 }
 
 /*Resets the client status for reuse by clearing results and data flags.*/
 void Client::reset()
 {
-    std::lock_guard<std::mutex> lock(clientMtx);
+    std::lock_guard<InstrumentedMutex> lock(clientMtx);
 
     resultReady = false;
     result.clear();
 
     dataReady = false;
     inputData.clear();
+    compression = XML::Compression::none;
+    traceId = 0;
+}
+
+/*
+ * Prepares the client for a new connection.
+ * The buffers keep their capacity , so a recycled client usually does not allocate ,
+ * only buffers grown by a large request are released.
+ */
+void Client::recycle(int socket, int id)
+{
+    reset();
+
+    clientSocket = socket;
+    this->id = id;
+    disconnected = false;
+    withDeadline = false;
+
+    if (readBuffer.capacity() > clientBufferKeep)
+        std::vector<char>().swap(readBuffer);
+
+    if (inputData.capacity() > clientBufferKeep)
+        std::string().swap(inputData);
 }
 
 bool Client::getResultReady() const
@@ -41,11 +69,11 @@ bool Client::getDataReady() const
 {
     return dataReady;
 }
-std::mutex &Client::getMutex()
+InstrumentedMutex &Client::getMutex()
 {
     return clientMtx;
 }
-std::condition_variable &Client::getCV()
+InstrumentedCondition &Client::getCV()
 {
     return cv;
 }
@@ -53,10 +81,6 @@ std::thread &Client::getThread()
 {
     return clientThread;
 }
-std::thread &Client::getParseThread()
-{
-    return parseThread;
-}
 int Client::getId() const
 {
     return id;
@@ -67,13 +91,49 @@ int Client::getClientSocket() const
 }
 const std::string& Client::getInputData() 
 {
-    std::lock_guard<std::mutex> lock(clientMtx);
+    std::lock_guard<InstrumentedMutex> lock(clientMtx);
     return inputData;
 }
-const std::string& Client::getResult() 
+XML::Compression Client::getCompression() const
+{
+    return compression;
+}
+std::vector<char> &Client::getReadBuffer()
+{
+    return readBuffer;
+}
+uint64_t Client::getTraceId() const
+{
+    return traceId;
+}
+std::chrono::steady_clock::time_point Client::getQueuedAt() const
+{
+    return queuedAt;
+}
+ResponseWriter &Client::getWriter()
+{
+    return writer;
+}
+bool Client::isDisconnected() const
 {
-    std::lock_guard<std::mutex> lock(clientMtx);
-    return result;
+    return disconnected;
+}
+void Client::setDisconnected(bool disconnected)
+{
+    this->disconnected = disconnected;
+}
+bool Client::hasDeadline() const
+{
+    return withDeadline;
+}
+std::chrono::steady_clock::time_point Client::getDeadline() const
+{
+    return deadline;
+}
+void Client::setDeadline(int timeout)
+{
+    withDeadline = timeout > 0;
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
 }
 void Client::setResultReady(bool resultReady)
 {
@@ -90,11 +150,6 @@ void Client::setThread(std::thread &&thread)
     clientThread = std::move(thread);
 }
 
-void Client::setParseThread(std::thread &&thread)
-{
-    parseThread = std::move(thread);
-}
-
 void Client::setId(int id)
 {
     this->id = id;
@@ -105,16 +160,36 @@ void Client::setClientSocket(int clientSocket)
     this->clientSocket = clientSocket;
 }
 
-void Client::setInputData(const std::string &inputData)
+void Client::setInputData(const char *inputData, size_t size)
 {
-    std::lock_guard<std::mutex> lock(clientMtx);
-    this->inputData = inputData;
+    std::lock_guard<InstrumentedMutex> lock(clientMtx);
+    this->inputData.assign(inputData, size);
     dataReady = true;
 }
 
-void Client::setResult(const std::string &result)
+void Client::setCompression(XML::Compression compression)
 {
-    std::lock_guard<std::mutex> lock(clientMtx);
-    this->result = result;
+    this->compression = compression;
+}
+void Client::setTraceId(uint64_t traceId)
+{
+    this->traceId = traceId;
+}
+void Client::setQueuedAt(std::chrono::steady_clock::time_point queuedAt)
+{
+    this->queuedAt = queuedAt;
+}
+
+/* Only the string is moved under clientMtx , the result is never copied.*/
+void Client::setResult(std::string &&result)
+{
+    std::lock_guard<InstrumentedMutex> lock(clientMtx);
+    this->result = std::move(result);
     resultReady = true;
 }
+
+std::string Client::takeResult()
+{
+    std::lock_guard<InstrumentedMutex> lock(clientMtx);
+    return std::move(result);
+}
@@ -0,0 +1,174 @@
+#include "dedup.hpp"
+
+#include <cstring>
+
+/*Round constants of SHA-256 (FIPS 180-4)*/
+static const uint32_t sha256Constants[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4,
+    0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE,
+    0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F,
+    0x4A7484AA, 0x5CB0A9DC, 0x76F988DA, 0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967, 0x27B70A85, 0x2E1B2138, 0x4D2C6DFC,
+    0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B,
+    0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070, 0x19A4C116,
+    0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7,
+    0xC67178F2};
+
+static uint32_t rotateRight(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+/* Mixes one 64 byte block into the state*/
+static void sha256Block(uint32_t state[8], const unsigned char *block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+               (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        uint32_t choose = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + choose + sha256Constants[i] + w[i];
+        uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+/**
+ *
+ * Implementation for "PayloadCache" class
+ *
+ */
+
+PayloadCache::PayloadCache(size_t capacity) : capacity {capacity}
+{
+}
+
+/*
+ * SHA-256 of data : whole blocks are read from data , the last one or two blocks are
+ * padded with 0x80 , zeros and the size in bits (big endian).
+ */
+std::string PayloadCache::digest(const char *data, size_t size)
+{
+    uint32_t state[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                         0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+        sha256Block(state, bytes + i);
+
+    unsigned char tail[128] = {0};
+    size_t rest = size - i;
+    memcpy(tail, bytes + i, rest);
+    tail[rest] = 0x80;
+
+    size_t tailSize = rest + 9 <= 64 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (int j = 0; j < 8; j++)
+        tail[tailSize - 1 - j] = static_cast<unsigned char>(bits >> (j * 8));
+
+    for (size_t j = 0; j < tailSize; j += 64)
+        sha256Block(state, tail + j);
+
+    std::string result(32, '\0');
+    for (int j = 0; j < 8; j++) {
+        result[j * 4] = static_cast<char>(state[j] >> 24);
+        result[j * 4 + 1] = static_cast<char>(state[j] >> 16);
+        result[j * 4 + 2] = static_cast<char>(state[j] >> 8);
+        result[j * 4 + 3] = static_cast<char>(state[j]);
+    }
+    return result;
+}
+
+bool PayloadCache::find(const std::string &digest, XML::Compression compression,
+                        std::string &answer)
+{
+    std::lock_guard<std::mutex> lock(cacheMtx);
+
+    auto it = index.find(digest);
+    if (it == index.end())
+        return false;
+
+    const Entry &entry = *it->second;
+    if (entry.compression != compression)
+        return false;
+
+    /*Moves the entry to the front (most recently used)*/
+    entries.splice(entries.begin(), entries, it->second);
+
+    answer = entry.answer;
+    return true;
+}
+
+void PayloadCache::store(const std::string &digest, XML::Compression compression,
+                         const std::string &answer)
+{
+    std::lock_guard<std::mutex> lock(cacheMtx);
+    if (capacity == 0)
+        return;
+
+    auto it = index.find(digest);
+    if (it != index.end()) {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    entries.push_front(Entry {digest, compression, answer});
+    index[digest] = entries.begin();
+
+    while (entries.size() > capacity) {
+        index.erase(entries.back().digest);
+        entries.pop_back();
+    }
+}
+
+/* Changes the capacity , least recently used payloads above it are dropped.*/
+void PayloadCache::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(cacheMtx);
+    this->capacity = capacity;
+
+    while (entries.size() > capacity) {
+        index.erase(entries.back().digest);
+        entries.pop_back();
+    }
+}
+
+size_t PayloadCache::getCapacity()
+{
+    std::lock_guard<std::mutex> lock(cacheMtx);
+    return capacity;
+}
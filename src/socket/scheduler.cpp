@@ -0,0 +1,181 @@
+#include "scheduler.hpp"
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+/*Bytes at the start of a request body searched for its operation*/
+const size_t classifyPrefixSize = 512;
+
+/**
+ *
+ * Implementation for "RequestScheduler" class
+ *
+ */
+
+RequestScheduler::RequestScheduler(int selectWeight, int maxSelectWorkers) :
+    selectWeight {std::max(1, selectWeight)},
+    maxSelectWorkers {std::max(0, maxSelectWorkers)},
+    insertsTaken {0},
+    runningSelects {0},
+    insertWait {Metrics::instance().histogram("queue.insert.wait")},
+    selectWait {Metrics::instance().histogram("queue.select.wait")}
+{
+}
+
+/*
+ * Returns the value of the attribute name in the start tag tag (the text between
+ * the element name and '>') , an empty string if the tag has no such attribute.
+ */
+static std::string attributeValue(const std::string &tag, const std::string &name)
+{
+    for (size_t at = tag.find(name); at != std::string::npos; at = tag.find(name, at + 1)) {
+        /*The name must be a whole attribute name , not the end of another one*/
+        if (at == 0 || ! isspace(static_cast<unsigned char>(tag[at - 1])))
+            continue;
+
+        size_t i = at + name.size();
+        while (i < tag.size() && isspace(static_cast<unsigned char>(tag[i])))
+            i++;
+        if (i == tag.size() || tag[i] != '=')
+            continue;
+
+        i++;
+        while (i < tag.size() && isspace(static_cast<unsigned char>(tag[i])))
+            i++;
+        if (i == tag.size() || (tag[i] != '"' && tag[i] != '\''))
+            continue;
+
+        size_t end = tag.find(tag[i], i + 1);
+        if (end == std::string::npos)
+            return "";
+
+        return tag.substr(i + 1, end - i - 1);
+    }
+    return "";
+}
+
+/*
+ * A select (or changes) is a small document whose <operation> element carries the
+ * type attribute near its start , so only the first bytes are searched , the root
+ * element may have any name (like the parser).
+ * A compressed body is not inflated here , it is classified as an insert (compressed
+ * bodies are documents). The class only orders the work , the parser still decides
+ * what the request is.
+ */
+RequestClass RequestScheduler::classify(const char *data, size_t size,
+                                        XML::Compression compression)
+{
+    if (compression != XML::Compression::none)
+        return RequestClass::insert;
+
+    std::string prefix(data, std::min(size, classifyPrefixSize));
+    const std::string element = "<operation";
+
+    for (size_t start = prefix.find(element); start != std::string::npos;
+         start = prefix.find(element, start + 1)) {
+        size_t nameEnd = start + element.size();
+        if (nameEnd == prefix.size() || ! isspace(static_cast<unsigned char>(prefix[nameEnd])))
+            continue;
+
+        size_t tagEnd = prefix.find('>', nameEnd);
+        if (tagEnd == std::string::npos)
+            break;
+
+        std::string type = attributeValue(prefix.substr(nameEnd, tagEnd - nameEnd), "type");
+        if (type == "select" || type == "changes")
+            return RequestClass::select;
+    }
+
+    return RequestClass::insert;
+}
+
+void RequestScheduler::push(Client *client, RequestClass requestClass)
+{
+    if (requestClass == RequestClass::select)
+        selects.push_back(client);
+    else
+        inserts.push_back(client);
+}
+
+/*
+ * Inserts are taken first , a waiting select is taken when a select worker is free
+ * and selectWeight inserts were taken since the last select (or no insert waits).
+ */
+Client *RequestScheduler::pop(RequestClass &requestClass)
+{
+    bool selectTurn = ! selects.empty() && canTakeSelect() &&
+                      (inserts.empty() || insertsTaken >= selectWeight);
+
+    Client *client;
+    if (selectTurn) {
+        client = selects.front();
+        selects.pop_front();
+
+        requestClass = RequestClass::select;
+        insertsTaken = 0;
+        runningSelects++;
+
+    } else if (! inserts.empty()) {
+        client = inserts.front();
+        inserts.pop_front();
+
+        requestClass = RequestClass::insert;
+        if (! selects.empty())
+            insertsTaken++;
+
+    } else
+        return nullptr;
+
+    auto waited = std::chrono::steady_clock::now() - client->getQueuedAt();
+    (requestClass == RequestClass::select ? selectWait : insertWait)
+        .add(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+
+    return client;
+}
+
+bool RequestScheduler::finished(RequestClass requestClass)
+{
+    if (requestClass != RequestClass::select)
+        return false;
+
+    runningSelects--;
+    return ! selects.empty() && canTakeSelect();
+}
+
+std::vector<Client *> RequestScheduler::takeAll()
+{
+    std::vector<Client *> waiting(inserts.begin(), inserts.end());
+    waiting.insert(waiting.end(), selects.begin(), selects.end());
+
+    inserts.clear();
+    selects.clear();
+
+    return waiting;
+}
+
+bool RequestScheduler::hasRunnable() const
+{
+    return ! inserts.empty() || (! selects.empty() && canTakeSelect());
+}
+
+bool RequestScheduler::empty() const
+{
+    return inserts.empty() && selects.empty();
+}
+
+void RequestScheduler::setSelectWeight(int selectWeight)
+{
+    this->selectWeight = std::max(1, selectWeight);
+}
+
+void RequestScheduler::setMaxSelectWorkers(int maxSelectWorkers)
+{
+    this->maxSelectWorkers = std::max(0, maxSelectWorkers);
+}
+
+bool RequestScheduler::canTakeSelect() const
+{
+    return maxSelectWorkers == 0 || runningSelects < maxSelectWorkers;
+}
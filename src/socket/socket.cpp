@@ -1,18 +1,43 @@
 #include "socket.hpp"
 
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
 /**
  * Implementation the "Socket" class
  */
 
 Socket::Socket(ServerConfiguration &serverConfig) :
+    ip {serverConfig.getIp()},
+    port {serverConfig.getPort()},
+    unixPath {serverConfig.getUnixPath()},
+    maxConnection {serverConfig.getMaxConnection()},
+    maxClients {serverConfig.getMaxClients()},
+    maxInFlight {serverConfig.getMaxInFlight()},
+    admissionWait {serverConfig.getAdmissionWait()},
+    headerTimeout {serverConfig.getHeaderTimeout()},
+    bodyTimeout {serverConfig.getBodyTimeout()},
+    idleTimeout {serverConfig.getIdleTimeout()},
+    acceptors {std::max(1, serverConfig.getAcceptors())},
+    activeClients {0},
+    inFlight {0},
+    writeHighWatermark {serverConfig.getWriteHighWatermark()},
+    writeTimeout {serverConfig.getWriteTimeout()},
+    payloadCache {static_cast<size_t>(std::max(0, serverConfig.getDedupCacheSize()))},
     sockfd {-1},
     isBound {false},
     isListening {false},
     clientsNum {0},
-    ip {serverConfig.getIp()},
-    port {serverConfig.getPort()},
-    maxConnection {serverConfig.getMaxConnection()}
+    scheduler {serverConfig.getSelectWeight(), serverConfig.getMaxSelectWorkers()}
 {
+    setCapturePath(serverConfig.getCapturePath());
 }
 
 Socket::~Socket()
@@ -22,87 +47,272 @@ Socket::~Socket()
         client = nullptr;
     }
 
+    for (Client *client : freeClients)
+        delete client;
+
     clients.clear();
+    finishedClients.clear();
+    freeClients.clear();
 }
 
 /*
- * Creates a TCP socket , binds it to the specified address ,and starts listening for incominng
- * clients connections.
+ * Creates the listening TCP sockets , binds them to the specified address ,and starts
+ * listening for incominng clients connections.
+ *
+ * With several acceptors every acceptor has its own listening socket bound with
+ * SO_REUSEPORT to the same address , so the kernel spreads new connections over them.
+ * If unixPath is set , one more acceptor serves the same protocol on an AF_UNIX socket.
+ * Acceptor 0 runs in the calling thread , the others in their own threads.
  */
 void Socket::createSocket()
 {
     try {
-        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = setup();
 
-        if (sockfd < 0) {
-            throw SocketException("Error creating socket!!!\n");
-        }
+        for (int i = 0; i < acceptors; i++)
+            listeners.push_back(createListener(address));
 
-        sockaddr_in address = setup();
-        int addressLen = sizeof(address);
+        if (! unixPath.empty())
+            listeners.push_back(createUnixListener());
 
-        bindSocket(address, addressLen);
+        sockfd = listeners.front();
         isBound = true;
-
-        listenForClients();
         isListening = true;
 
-        acceptClient(address, addressLen);
+        coutMtx.lock();
+        std::cout << "Listening on " << ip << ":" << port << " with " << acceptors
+                  << " acceptors.\n";
+        if (! unixPath.empty())
+            std::cout << "Listening on " << unixPath << ".\n";
+        coutMtx.unlock();
+
+        for (size_t i = 1; i < listeners.size(); i++)
+            acceptorThreads.emplace_back(&Socket::runAcceptor, this, i);
+
+        acceptClient(0);
 
     } catch (const SocketException &se) {
         std::cerr << "Error : " << se.what();
         if (isOpen())
             stop();
+        else
+            closeListeners();
     }
+
+    for (std::thread &acceptorThread : acceptorThreads)
+        acceptorThread.join();
+    acceptorThreads.clear();
+}
+
+/* Creates one listening socket , shares the port with the other acceptors.*/
+int Socket::createListener(sockaddr_in address)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw SocketException("Error creating socket!!!\n");
+    }
+
+    /*Not set for one acceptor , so a second server on the same port still fails to bind*/
+    int enable = 1;
+    if (acceptors > 1 &&
+        setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+        close(listener);
+        throw SocketException("SO_REUSEPORT failed!!!\n");
+    }
+
+    try {
+        bindSocket(listener, address, sizeof(address));
+        listenForClients(listener);
+
+    } catch (const SocketException &) {
+        close(listener);
+        throw;
+    }
+
+    return listener;
 }
 
 /*
- * Accepts incoming client connections and creates a new Client	object
- * for each connected client. each client is handled in a new thread.
+ * Creates the AF_UNIX listening socket.
+ * A socket file left by a previous run is removed , any other file at the path is an error.
  */
-void Socket::acceptClient(sockaddr_in address, int addressLen)
+int Socket::createUnixListener()
 {
-    while (true) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (unixPath.size() >= sizeof(address.sun_path))
+        throw SocketException("Unix socket path is too long: " + unixPath + "\n");
+
+    strncpy(address.sun_path, unixPath.c_str(), sizeof(address.sun_path) - 1);
+
+    struct stat pathStat;
+    if (lstat(unixPath.c_str(), &pathStat) == 0) {
+        if (! S_ISSOCK(pathStat.st_mode))
+            throw SocketException("Unix socket path exists and is not a socket: " + unixPath +
+                                  "\n");
+        unlink(unixPath.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw SocketException("Error creating unix socket!!!\n");
+    }
+
+    if (bind(listener, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        close(listener);
+        throw SocketException("Bind failed: " + unixPath + "\n");
+    }
+
+    try {
+        listenForClients(listener);
+
+    } catch (const SocketException &) {
+        close(listener);
+        unlink(unixPath.c_str());
+        throw;
+    }
+
+    return listener;
+}
+
+/* Runs an acceptor in its own thread , an accept error stops the server.*/
+void Socket::runAcceptor(int acceptor)
+{
+    try {
+        acceptClient(acceptor);
+
+    } catch (const SocketException &se) {
+        std::cerr << "Error : acceptor " << acceptor << " : " << se.what();
+        if (isOpen())
+            stop();
+    }
+}
+
+/*
+ * Accepts incoming client connections on the listening socket of the acceptor and
+ * assigns a Client object (a reused one if possible) to each connected client.
+ * each client is handled in a new thread.
+ */
+void Socket::acceptClient(int acceptor)
+{
+    /*The acceptor after the TCP acceptors is the unix acceptor*/
+    std::string name = acceptor < acceptors ? std::to_string(acceptor) : "unix";
+    Counter &accepted = Metrics::instance().counter("acceptor." + name + ".accepted");
+
+    while (isOpen()) {
+        sockaddr_storage address;
+        socklen_t addressLen = sizeof(address);
+
         /*Accepts new connection*/
-        int newClientSocket = accept(sockfd, (struct sockaddr *) &address,
-                                     (socklen_t *) &addressLen);
+        int newClientSocket =
+            accept(listeners[acceptor], (struct sockaddr *) &address, &addressLen);
         if (newClientSocket < 0) {
+            /*The listening socket is closed by stop*/
+            if (! isOpen())
+                break;
+
             throw SocketException("Exception in accept!!!\n");
         }
+        accepted.add();
+
+        /*Admission control : over the limit the connection is rejected at once*/
+        if (activeClients.fetch_add(1) >= maxClients) {
+            activeClients--;
+            rejectConnection(newClientSocket);
+            continue;
+        }
+        Metrics::instance().counter("connections.accepted").add();
+        Metrics::instance().counter("connections.active").add();
 
-        /*Increments client counter*/
-        clientsNum++;
+        /*Client sockets are non-blocking , reads and writes wait with poll*/
+        fcntl(newClientSocket, F_SETFL, fcntl(newClientSocket, F_GETFL, 0) | O_NONBLOCK);
 
-        /*Creates a new client object*/
-        Client *client = new Client {newClientSocket, clientsNum};
+        /*Reclaims closed clients , then takes a client object*/
+        reclaimClients();
+        Client *client = obtainClient(newClientSocket);
+        client->getWriter().reset(newClientSocket, writeHighWatermark, writeTimeout);
 
         /*Lanches client handler in new thread*/
         std::thread clientThread(&Socket::handleClient, this, client);
 
         client->setThread(std::move(clientThread));
+    }
+}
+
+/*
+ * Returns a free client prepared for the connection , or a new client if none is free.
+ * The client is added to the manage list (thread-safe , acceptors share the lists).
+ */
+Client *Socket::obtainClient(int clientSocket)
+{
+    std::lock_guard<InstrumentedMutex> lock(socketMtx);
+
+    /*Increments client counter*/
+    clientsNum++;
+
+    Client *client;
+    if (freeClients.empty()) {
+        client = new Client {clientSocket, clientsNum};
+    } else {
+        client = freeClients.back();
+        freeClients.pop_back();
+
+        client->recycle(clientSocket, clientsNum);
+        Metrics::instance().counter("clients.reused").add();
+    }
+
+    clients.push_back(client);
+    return client;
+}
+
+/*
+ * Joins the threads of clients that finished since the last accept and moves them
+ * from clients to freeClients , so the number of client objects follows the number
+ * of concurrent connections.
+ */
+void Socket::reclaimClients()
+{
+    std::vector<Client *> finished;
+    {
+        std::lock_guard<InstrumentedMutex> lock(socketMtx);
+        finished.swap(finishedClients);
+
+        for (Client *client : finished)
+            clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+    }
 
-        /*Adds client to manage list (thread-safe)*/
-        std::lock_guard<std::mutex> lock(socketMtx);
-        clients.push_back(client);
+    for (Client *client : finished) {
+        /*The handler thread has already left handleClient , join returns at once*/
+        if (client->getThread().joinable())
+            client->getThread().join();
     }
+
+    std::lock_guard<InstrumentedMutex> lock(socketMtx);
+    freeClients.insert(freeClients.end(), finished.begin(), finished.end());
 }
 
 /*
  * Handles communication with the connected client ,including reading data from the client ,
  * processing it and sending back results.
+ *
+ * Output goes through the ResponseWriter of the client , it is flushed before
+ * reading the next input. The loop ends when the client closes the connection
+ * or stops receiving data.
  * */
 void Socket::handleClient(Client *client)
 {
-    int clientSocket = client->getClientSocket();
-
     /*Log client connection*/
     printClientJoin(client);
 
-    while (isOpen()) {
+    while (isOpen() && ! client->isDisconnected()) {
         /*Gets data size from client*/
         std::string lengthMsg = "\nEnter the data length as 15 digits : \n";
-        write(clientSocket, lengthMsg.c_str(), lengthMsg.length());
+        if (! sendToClient(client, lengthMsg))
+            break;
 
+        client->setDeadline(headerTimeout);
         int size = readDataSize(client);
 
         /*Skips if invalid size*/
@@ -111,42 +321,68 @@ void Socket::handleClient(Client *client)
 
         /*Gets actual data from client*/
         std::string dataMsg = "\nEnter the data of size " + std::to_string(size) + " : \n";
-        write(clientSocket, dataMsg.c_str(), dataMsg.length());
+        if (! sendToClient(client, dataMsg))
+            break;
+
+        /*A sampled request is traced from its body to its answer*/
+        uint64_t traceId = Tracer::instance().startRequest();
+        Tracer::setCurrent(traceId);
+        client->setTraceId(traceId);
+
+        TraceSpan requestSpan {"request"};
+        TraceSpan readSpan {"read"};
 
         /*
-         * Buffer to store client's data
+         * Buffer of the client to store client's data
          * 1024 bytes for additional input
          */
-        char buffer[size + 1024];
-        if (int bytesRead = readData(client, buffer, size) <= 0) {
+        std::vector<char> &buffer = client->getReadBuffer();
+        buffer.resize(size + 1024);
+
+        client->setDeadline(bodyTimeout);
+        if (int bytesRead = readData(client, buffer.data(), size) <= 0) {
             continue;
         }
+        readSpan.end();
 
-        /*Processes client data*/
-        client->setInputData(buffer);
+        capture.record(client->getId(), client->getCompression(), buffer.data(), size);
 
-        pushToQueue(client);
+        /*A payload identical to a recently stored one is answered without parsing*/
+        bool dedup = payloadCache.getCapacity() > 0;
+        std::string payloadDigest = dedup ? PayloadCache::digest(buffer.data(), size) : "";
+        std::string cachedAnswer;
 
-        /*Notify worker thread*/
-        cv.notify_one();
+        if (dedup && payloadCache.find(payloadDigest, client->getCompression(), cachedAnswer)) {
+            Metrics::instance().counter("dedup.hits").add();
+            client->getWriter().write(std::move(cachedAnswer));
 
-        printClientData(client);
+        } else if (! processRequest(client, buffer.data(), size)) {
+            continue;
 
-        /*Waits for processing to complete*/
-        {
-            std::unique_lock<std::mutex> lock(client->getMutex());
-            client->getCV().wait(lock, [client] { return client->getResultReady(); });
-        }
+        } else {
+            std::string result = client->takeResult();
 
-        /*Sends result back to client*/
-        write(clientSocket, client->getResult().c_str(), client->getResult().length());
+            /*Only stored payloads are cached , selects and errors are processed again*/
+            if (dedup && result.compare(0, 7, "done :)") == 0)
+                payloadCache.store(payloadDigest, client->getCompression(),
+                                   "done :) already stored\n");
+
+            client->getWriter().write(std::move(result));
+        }
 
         client->reset();
 
-        /*Checks if client wants to continue*/
+        /*The answer is written together with the continue prompt , in one system call*/
+        TraceSpan writeSpan {"write"};
         std::string continueMsg = "\nPress 'y' if you want to continue .\n";
-        write(clientSocket, continueMsg.c_str(), continueMsg.length());
+        bool sent = sendToClient(client, continueMsg);
+        writeSpan.end();
+        requestSpan.end();
 
+        if (! sent)
+            break;
+
+        client->setDeadline(idleTimeout);
         char userChoice = readClientChoice(client);
 
         if (userChoice != 'y')
@@ -156,6 +392,81 @@ void Socket::handleClient(Client *client)
     closeClient(client);
 }
 
+/*
+ * Queues message and writes all pending output of the client.
+ * A client that cannot receive data is marked as disconnected.
+ */
+bool Socket::sendToClient(Client *client, const std::string &message)
+{
+    ResponseWriter &writer = client->getWriter();
+
+    if (! writer.write(message) || ! writer.flush()) {
+        client->setDisconnected(true);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Reads up to size bytes from the non-blocking client socket.
+ * Waits with poll while no data is available , until the deadline of the client.
+ * Returns number of bytes , or -1 if the client closed the connection , the deadline
+ * expired or an error occurred (the client is marked as disconnected).
+ */
+int Socket::readFromClient(Client *client, char *buffer, int size)
+{
+    while (true) {
+        int bytesRead = read(client->getClientSocket(), buffer, size);
+        if (bytesRead > 0)
+            return bytesRead;
+
+        if (bytesRead < 0 && errno == EINTR)
+            continue;
+
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitReadable(client))
+            continue;
+
+        client->setDisconnected(true);
+        return -1;
+    }
+}
+
+/*
+ * Waits until the client socket has data to read or the deadline of the client expires.
+ * An expired client gets a timeout message and is counted in connections.timedOut.
+ */
+bool Socket::waitReadable(Client *client)
+{
+    pollfd descriptor;
+    descriptor.fd = client->getClientSocket();
+    descriptor.events = POLLIN;
+
+    int ready;
+    do {
+        int timeout = -1;
+        if (client->hasDeadline()) {
+            auto remaining = client->getDeadline() - std::chrono::steady_clock::now();
+            timeout = std::max<long long>(
+                0, std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+        }
+
+        ready = poll(&descriptor, 1, timeout);
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready == 0) {
+        Metrics::instance().counter("connections.timedOut").add();
+
+        std::string timeoutMsg = "\nTimeout : connection closed.\n";
+        sendToClient(client, timeoutMsg);
+
+        coutMtx.lock();
+        std::cout << "client with id " << client->getId() << " timed out.\n";
+        coutMtx.unlock();
+    }
+
+    return ready > 0;
+}
+
 /*
  * Reads a single characters choice from the client to determine
  * whether to continue or stop processing.
@@ -169,10 +480,10 @@ void Socket::handleClient(Client *client)
 char Socket::readClientChoice(Client *client)
 {
     char buffer[128];
-    int bytesRead = read(client->getClientSocket(), buffer, sizeof(buffer));
+    int bytesRead = readFromClient(client, buffer, sizeof(buffer));
     if (bytesRead < 1) {
         std::string message = "Server stoped. \n";
-        write(client->getClientSocket(), message.c_str(), message.length());
+        sendToClient(client, message);
 
         return '\0';
     }
@@ -185,6 +496,10 @@ char Socket::readClientChoice(Client *client)
  * Reads the size of the data that the client intends to sent.
  * the size must be a 15 digits string.
  *
+ * The character after the digits selects the compression of the data :
+ * 'g' -> gzip , 'd' -> deflate , anything else (newline) -> not compressed.
+ * For compressed data the size is the compressed size.
+ *
  * Note: The buffer size is set to 1024 bytes,
  * although we only read 15 characters from the buffer.
  * this is done to handle additional input from the client
@@ -197,13 +512,23 @@ int Socket::readDataSize(Client *client)
     /*Clears buffer*/
     memset(buffer, 0, sizeof(buffer));
 
-    int bytesRead = read(client->getClientSocket(), buffer, sizeof(buffer));
+    int bytesRead = readFromClient(client, buffer, sizeof(buffer));
+    if (bytesRead < 0)
+        return -1;
+
     if (bytesRead < 15) {
         std::string message = "Your input is less than 15 digits.\n";
-        write(client->getClientSocket(), message.c_str(), message.length());
+        sendToClient(client, message);
         return -1;
     }
 
+    if (bytesRead > 15 && buffer[15] == 'g')
+        client->setCompression(XML::Compression::gzip);
+    else if (bytesRead > 15 && buffer[15] == 'd')
+        client->setCompression(XML::Compression::deflate);
+    else
+        client->setCompression(XML::Compression::none);
+
     buffer[15] = '\0';
     try {
         int size = std::stoi(buffer);
@@ -211,12 +536,12 @@ int Socket::readDataSize(Client *client)
 
     } catch (const std::invalid_argument &e) {
         std::string invalidError = "Invalid argument cannot convert to integer.\n";
-        write(client->getClientSocket(), invalidError.c_str(), invalidError.length());
+        sendToClient(client, invalidError);
         return -1;
 
     } catch (const std::out_of_range &e) {
         std::string outOfRangeError = "Out of range error: value is too large.\n";
-        write(client->getClientSocket(), outOfRangeError.c_str(), outOfRangeError.length());
+        sendToClient(client, outOfRangeError);
         return -1;
     }
 }
@@ -226,7 +551,7 @@ int Socket::readData(Client *client, char *buffer, int size)
     int totalRead = 0;
 
     while (totalRead < size) {
-        int bytesRead = read(client->getClientSocket(), buffer + totalRead, size - totalRead);
+        int bytesRead = readFromClient(client, buffer + totalRead, size - totalRead);
 
         if (bytesRead < 0) {
             return -1;
@@ -255,11 +580,65 @@ int Socket::readData(Client *client, char *buffer, int size)
     return totalRead;
 }
 
-/*Pushes the Client object to the waitingClients queue for processing.*/
-void Socket::pushToQueue(Client *client)
+/*
+ * Pushes the Client object to the queue of its class for processing.
+ * The wait in the queue is recorded by the scheduler , and as a span of a traced request.
+ */
+void Socket::pushToQueue(Client *client, RequestClass requestClass)
+{
+    client->setQueuedAt(std::chrono::steady_clock::now());
+
+    std::lock_guard<InstrumentedMutex> lock(socketMtx);
+    scheduler.push(client, requestClass);
+}
+
+/*
+ * Rejects a connection with an explicit busy message.
+ * The message is sent without waiting , the client may already be gone.
+ */
+void Socket::rejectConnection(int clientSocket)
 {
-    std::lock_guard<std::mutex> lock(socketMtx);
-    waitingClients.push(client);
+    std::string busyMsg = "Server busy : too many clients , try again later.\n";
+    send(clientSocket, busyMsg.c_str(), busyMsg.length(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(clientSocket);
+
+    Metrics::instance().counter("connections.rejected").add();
+
+    coutMtx.lock();
+    std::cout << "connection rejected : " << maxClients << " clients connected.\n";
+    coutMtx.unlock();
+}
+
+/*
+ * Takes an in-flight slot for a request.
+ * Waits at most admissionWait milliseconds , so a traffic spike is answered with a
+ * busy message instead of an unbounded queue.
+ */
+bool Socket::acquireRequestSlot()
+{
+    InstrumentedLock lock(socketMtx);
+
+    /*No new request is accepted while the server drains*/
+    if (! isOpen())
+        return false;
+
+    bool admitted = inFlightCV.wait_for(lock, std::chrono::milliseconds(admissionWait.load()),
+                                        [this] { return inFlight < maxInFlight; });
+    if (admitted)
+        inFlight++;
+
+    return admitted;
+}
+
+/* Releases the in-flight slot of a finished request.*/
+void Socket::releaseRequestSlot()
+{
+    {
+        std::lock_guard<InstrumentedMutex> lock(socketMtx);
+        inFlight--;
+    }
+    /*Wakes waiting requests and a draining stop*/
+    inFlightCV.notify_all();
 }
 
 /* Stops the server by closing the socket and cleaning up resources. */
@@ -268,33 +647,176 @@ void Socket::stop()
     isBound = false;
     isListening = false;
 
-    shutdown(sockfd, SHUT_RD);
-    close(sockfd);
+    closeListeners();
     sockfd = -1;
 
-    cv.notify_one();
+    /*Wakes all workers so they can exit*/
+    cv.notify_all();
 
     std::cout << "Server stoped.\n";
 }
 
+/*
+ * Passes the data of client to the workers and waits for the result.
+ * The request takes an in-flight slot until its result is ready , the caller takes the
+ * result and writes it.
+ */
+bool Socket::processRequest(Client *client, const char *data, int size)
+{
+    /*
+     * Waits for a free in-flight slot , rejects the request if none becomes free.
+     * The message is written with the next length prompt.
+     */
+    if (! acquireRequestSlot()) {
+        Metrics::instance().counter("requests.rejected").add();
+        client->getWriter().write("\nServer busy : request rejected , try again later.\n");
+        return false;
+    }
+
+    /*Processes client data*/
+    client->setInputData(data, size);
+
+    pushToQueue(client, RequestScheduler::classify(data, size, client->getCompression()));
+
+    /*Notify worker thread*/
+    cv.notify_one();
+
+    printClientData(client);
+
+    /*
+     * Waits for processing to complete.
+     * Select results are already streamed to the writer by the worker.
+     */
+    {
+        InstrumentedLock lock(client->getMutex());
+        client->getCV().wait(lock, [client] { return client->getResultReady(); });
+    }
+
+    releaseRequestSlot();
+
+    return true;
+}
+
+/* Applies the runtime settings of a reloaded configuration.*/
+void Socket::applyConfiguration(const ServerConfiguration &serverConfig)
+{
+    writeHighWatermark = serverConfig.getWriteHighWatermark();
+    writeTimeout = serverConfig.getWriteTimeout();
+    maxClients = serverConfig.getMaxClients();
+    admissionWait = serverConfig.getAdmissionWait();
+    headerTimeout = serverConfig.getHeaderTimeout();
+    bodyTimeout = serverConfig.getBodyTimeout();
+    idleTimeout = serverConfig.getIdleTimeout();
+
+    payloadCache.setCapacity(std::max(0, serverConfig.getDedupCacheSize()));
+
+    try {
+        setCapturePath(serverConfig.getCapturePath());
+
+    } catch (const std::runtime_error &e) {
+        std::cerr << "Error : " << e.what();
+    }
+
+    /*A larger limit admits waiting requests at once , more select workers take waiting selects*/
+    {
+        std::lock_guard<InstrumentedMutex> lock(socketMtx);
+        maxInFlight = serverConfig.getMaxInFlight();
+        scheduler.setSelectWeight(serverConfig.getSelectWeight());
+        scheduler.setMaxSelectWorkers(serverConfig.getMaxSelectWorkers());
+    }
+    inFlightCV.notify_all();
+    cv.notify_all();
+}
+
+/* Opens the capture file of a new path , prints where requests are recorded.*/
+void Socket::setCapturePath(const std::string &path)
+{
+    if (path == capture.getPath() && (capture.isRecording() || path.empty()))
+        return;
+
+    capture.setPath(path);
+
+    coutMtx.lock();
+    if (path.empty())
+        std::cout << "Capture : stopped.\n";
+    else
+        std::cout << "Capture : recording requests to " << path << ".\n";
+    coutMtx.unlock();
+}
+
+/*
+ * Drains the server before shut down :
+ * 1.Stops accepting new clients.
+ * 2.Waits until queued and in-flight requests are answered , at most timeout milliseconds.
+ * 3.Answers requests that are still queued without processing them.
+ * 4.Shuts down client connections , so client threads leave their reads and finish.
+ *
+ * Requests already taken by a worker are completed by that worker.
+ */
+void Socket::drain(int timeout)
+{
+    if (isOpen())
+        stop();
+
+    InstrumentedLock lock(socketMtx);
+
+    bool drained = inFlightCV.wait_for(lock, std::chrono::milliseconds(timeout),
+                                       [this] { return inFlight == 0; });
+    if (! drained) {
+        coutMtx.lock();
+        std::cout << "Drain timeout : " << inFlight << " requests are not finished.\n";
+        coutMtx.unlock();
+
+        for (Client *client : scheduler.takeAll()) {
+            client->setResult("\nServer stopped : request is not processed.\n");
+            client->getCV().notify_one();
+
+            Metrics::instance().counter("requests.cancelled").add();
+        }
+    }
+
+    for (Client *client : clients) {
+        if (client->getClientSocket() >= 0)
+            shutdown(client->getClientSocket(), SHUT_RDWR);
+    }
+}
+
 /* Checks if the socket is currently running(bound and listening)*/
 bool Socket::isOpen()
 {
     return isBound && isListening && sockfd > 0;
 }
 
+void Socket::flushCapture()
+{
+    capture.flush();
+}
+
+/* Shuts down and closes every listening socket , wakes acceptors blocked in accept.*/
+void Socket::closeListeners()
+{
+    for (int listener : listeners) {
+        shutdown(listener, SHUT_RD);
+        close(listener);
+    }
+
+    /*Removes the socket file , only if the unix listener was created*/
+    if (! unixPath.empty() && static_cast<int>(listeners.size()) > acceptors)
+        unlink(unixPath.c_str());
+}
+
 /* Binds the socket to the specified address */
-void Socket::bindSocket(sockaddr_in address, int addressLen)
+void Socket::bindSocket(int listener, sockaddr_in address, int addressLen)
 {
-    if (bind(sockfd, (struct sockaddr *) &address, addressLen) < 0) {
+    if (bind(listener, (struct sockaddr *) &address, addressLen) < 0) {
         throw SocketException("Bind failed!!!\n");
     }
 }
 
 /* Sets up the server socket to listen for incoming client connections.*/
-void Socket::listenForClients()
+void Socket::listenForClients(int listener)
 {
-    if (listen(sockfd, maxConnection) < 0) {
+    if (listen(listener, maxConnection) < 0) {
         throw SocketException("Listen failed!!!\n");
     }
 }
@@ -319,7 +841,12 @@ sockaddr_in Socket::setup()
 void Socket::printClientData(Client *client)
 {
     coutMtx.lock();
-    std::cout << "received from " << client->getId() << "\n" << client->getInputData() << std::endl;
+    if (client->getCompression() == XML::Compression::none)
+        std::cout << "received from " << client->getId() << "\n"
+                  << client->getInputData() << std::endl;
+    else
+        std::cout << "received from " << client->getId() << "\n"
+                  << client->getInputData().length() << " compressed bytes" << std::endl;
     coutMtx.unlock();
 }
 
@@ -340,9 +867,18 @@ void Socket::printClientJoin(Client *client)
 /*Closes the socket connection for the specified client and prints a close message.*/
 void Socket::closeClient(Client *client)
 {
+    activeClients--;
+    Metrics::instance().counter("connections.active").add(-1);
+    printClientClose(client);
+
+    /*
+     * The socket is closed under socketMtx so drain never shuts down a reused
+     * descriptor , the client is reused after its thread is joined by the accepting thread.
+     */
+    std::lock_guard<InstrumentedMutex> lock(socketMtx);
     close(client->getClientSocket());
     client->setClientSocket(-1);
-    printClientClose(client);
+    finishedClients.push_back(client);
 }
 
 int Socket::getSockfd() const
@@ -353,15 +889,15 @@ const std::vector<Client *> &Socket::getClients()
 {
     return clients;
 }
-std::queue<Client *> &Socket::getWaitingClients()
+RequestScheduler &Socket::getScheduler()
 {
-    return waitingClients;
+    return scheduler;
 }
-std::mutex &Socket::getMutex()
+InstrumentedMutex &Socket::getMutex()
 {
     return socketMtx;
 }
-std::condition_variable &Socket::getCV()
+InstrumentedCondition &Socket::getCV()
 {
     return cv;
 }
@@ -0,0 +1,239 @@
+#include "writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/*Borrowed data below this size is copied into the queue , so it is sent with later output*/
+const size_t writerCopySize = 16 * 1024;
+
+/*Chunks gathered by one sendmsg*/
+const size_t writerMaxVectors = 64;
+
+/**
+ *
+ * Implementation for "ResponseWriter" class
+ *
+ */
+
+ResponseWriter::ResponseWriter() :
+    socket {-1},
+    offset {0},
+    pendingBytes {0},
+    highWatermark {0},
+    writeTimeout {-1},
+    failed {false}
+{
+}
+
+void ResponseWriter::reset(int socket, size_t highWatermark, int writeTimeout)
+{
+    this->socket = socket;
+    this->highWatermark = highWatermark;
+    this->writeTimeout = writeTimeout;
+
+    chunks.clear();
+    offset = 0;
+    pendingBytes = 0;
+    failed = false;
+}
+
+/*
+ * Backpressure : if the pending output is above the high watermark , the writer
+ * first flushes down to half of it , so the caller stops producing until
+ * the client has received enough.
+ */
+bool ResponseWriter::write(const char *data, size_t size)
+{
+    if (failed)
+        return false;
+
+    if (pendingBytes > highWatermark && ! flushTo(highWatermark / 2))
+        return false;
+
+    return queue(data, size);
+}
+
+/*
+ * Small data is copied into the queue.
+ * Large data (a chunk of a select result) is written right away behind the queued
+ * chunks , the caller keeps its buffer and only the part that the socket buffer
+ * cannot take is copied.
+ */
+bool ResponseWriter::queue(const char *data, size_t size)
+{
+    if (failed)
+        return false;
+
+    if (size < writerCopySize) {
+        if (size > 0) {
+            pendingBytes += size;
+            chunks.emplace_back(data, size);
+        }
+        return true;
+    }
+
+    ssize_t bytesWritten = sendQueued(data, size);
+    if (bytesWritten < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+            failed = true;
+            return false;
+        }
+        bytesWritten = 0;
+    }
+
+    if (static_cast<size_t>(bytesWritten) < size) {
+        pendingBytes += size - bytesWritten;
+        chunks.emplace_back(data + bytesWritten, size - bytesWritten);
+    }
+
+    return true;
+}
+
+bool ResponseWriter::write(const std::string &data)
+{
+    return write(data.data(), data.length());
+}
+
+/* Queues data , like write(const char *) but the string is moved into the queue.*/
+bool ResponseWriter::write(std::string &&data)
+{
+    if (failed)
+        return false;
+
+    if (data.empty())
+        return true;
+
+    if (pendingBytes > highWatermark && ! flushTo(highWatermark / 2))
+        return false;
+
+    pendingBytes += data.length();
+    chunks.push_back(std::move(data));
+
+    return true;
+}
+
+bool ResponseWriter::flush()
+{
+    return flushTo(0);
+}
+
+bool ResponseWriter::drain()
+{
+    return flushTo(highWatermark / 2);
+}
+
+bool ResponseWriter::isFull() const
+{
+    return pendingBytes > highWatermark;
+}
+
+/*
+ * Writes the queued chunks until at most limit bytes are pending.
+ *
+ * sendmsg may write only a part of the chunks , the written part of the first
+ * chunk is remembered in offset. When the socket buffer is full (EAGAIN) the
+ * writer waits with poll.
+ */
+bool ResponseWriter::flushTo(size_t limit)
+{
+    while (! failed && pendingBytes > limit) {
+        if (sendQueued(nullptr, 0) >= 0)
+            continue;
+
+        if (errno == EINTR)
+            continue;
+
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable())
+            continue;
+
+        failed = true;
+    }
+    return ! failed;
+}
+
+/*
+ * Gathers up to writerMaxVectors chunks , and extra if all chunks fit , into one
+ * sendmsg. sendmsg is used instead of writev for MSG_NOSIGNAL , a closed client
+ * returns EPIPE instead of killing the server.
+ */
+ssize_t ResponseWriter::sendQueued(const char *extra, size_t extraSize)
+{
+    iovec vectors[writerMaxVectors];
+    size_t count = 0;
+    size_t skip = offset;
+
+    for (auto chunk = chunks.begin(); chunk != chunks.end() && count < writerMaxVectors - 1;
+         ++chunk) {
+        vectors[count].iov_base = const_cast<char *>(chunk->data()) + skip;
+        vectors[count].iov_len = chunk->length() - skip;
+        skip = 0;
+        count++;
+    }
+
+    if (extraSize > 0 && count == chunks.size()) {
+        vectors[count].iov_base = const_cast<char *>(extra);
+        vectors[count].iov_len = extraSize;
+        count++;
+    }
+
+    if (count == 0)
+        return 0;
+
+    msghdr message {};
+    message.msg_iov = vectors;
+    message.msg_iovlen = count;
+
+    ssize_t bytesWritten = sendmsg(socket, &message, MSG_NOSIGNAL);
+    if (bytesWritten < 0)
+        return -1;
+
+    size_t queuedBytes = std::min(static_cast<size_t>(bytesWritten), pendingBytes);
+    consume(queuedBytes);
+
+    return bytesWritten - queuedBytes;
+}
+
+void ResponseWriter::consume(size_t size)
+{
+    pendingBytes -= size;
+
+    while (size > 0) {
+        size_t remaining = chunks.front().length() - offset;
+
+        if (size < remaining) {
+            offset += size;
+            return;
+        }
+
+        size -= remaining;
+        chunks.pop_front();
+        offset = 0;
+    }
+}
+
+/* Waits until the socket is writable or the write timeout expires.*/
+bool ResponseWriter::waitWritable()
+{
+    pollfd descriptor;
+    descriptor.fd = socket;
+    descriptor.events = POLLOUT;
+
+    int ready;
+    do {
+        ready = poll(&descriptor, 1, writeTimeout);
+    } while (ready < 0 && errno == EINTR);
+
+    return ready > 0 && ! (descriptor.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
+
+size_t ResponseWriter::getPendingBytes() const
+{
+    return pendingBytes;
+}
+bool ResponseWriter::isFailed() const
+{
+    return failed;
+}
@@ -0,0 +1,231 @@
+/**
+ *
+ * \file : main.cpp
+ *
+ * dbm-workload : writes generated documents and select requests as xml files , as a
+ * capture file for dbm-replay or to the standard output.
+ *
+ * \author : MohammadDerhami
+ */
+
+#include "capture.hpp"
+#include "workload.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * @struct WorkloadOutput
+ * @brief what dbm-workload writes and where.
+ */
+struct WorkloadOutput
+{
+    long long count = 1000;
+
+    /*Directory of document files (for dbm -i)*/
+    std::string documentDirectory;
+
+    /*Directory of select request files , one for each table and one for all tables*/
+    std::string selectDirectory;
+
+    /*Capture file (for dbm-replay) , its connections , requests per second and selects*/
+    std::string capturePath;
+    int connections = 4;
+    double rate = 100;
+    double selectRatio = 0;
+};
+
+/*Prints the help message for command-line usage.*/
+static void printHelp()
+{
+    std::cout << "Usage:\n"
+                 "  ./dbm-workload [options]\n\n"
+                 "Shape of documents :\n"
+                 "  -s <seed>       : seed of the generator (1) , same seed -> same documents.\n"
+                 "  -t <tables>     : main tables , used by documents in turn (1).\n"
+                 "  -d <depth>      : levels of nested objects (2).\n"
+                 "  -f <fan-out>    : child objects of every object (2).\n"
+                 "  -p <properties> : properties of every object (4).\n"
+                 "  -v <size>       : characters of every value (16).\n"
+                 "  -u <ratio>      : fraction of documents resent byte-identical (0).\n\n"
+                 "Output (documents go to the standard output , one per line , without -o or -c) :\n"
+                 "  -n <count>      : number of requests (1000).\n"
+                 "  -o <directory>  : writes every document to a file , for ./dbm -i <directory>.\n"
+                 "  -e <directory>  : writes a select request of every table and of all tables.\n"
+                 "  -c <file>       : writes a capture file , for ./dbm-replay -c <file>.\n"
+                 "  -k <count>      : connections of the capture (4).\n"
+                 "  -r <rate>       : requests per second of the capture (100 , 0 -> at once).\n"
+                 "  -q <ratio>      : fraction of capture requests that are selects (0).\n"
+                 "  -h              : Display this help message.\n";
+}
+
+/* Creates a directory , an existing directory is used.*/
+static void createDirectory(const std::string &path)
+{
+    if (mkdir(path.c_str(), 0755) < 0 && errno != EEXIST)
+        throw std::runtime_error("Unable to create directory: " + path + "\n");
+}
+
+static void writeFile(const std::string &path, const std::string &data)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (! file.is_open() || ! (file << data))
+        throw std::runtime_error("Failed to write file : " + path + "\n");
+}
+
+/* Writes the select requests of all tables of the schema.*/
+static void writeSelects(WorkloadGenerator &generator, const std::string &directory)
+{
+    createDirectory(directory);
+
+    for (const std::string &table : generator.getTableNames())
+        writeFile(directory + "/select_" + table + ".xml",
+                  WorkloadGenerator::selectRequest(table));
+
+    writeFile(directory + "/select_all.xml", WorkloadGenerator::selectRequest(""));
+}
+
+/*
+ * Writes the requests , request i is sent on connection i % connections at
+ * i / rate seconds.
+ */
+static void writeRequests(WorkloadGenerator &generator, const WorkloadOutput &output)
+{
+    /*A new capture , an existing file would be appended to*/
+    CaptureWriter capture;
+    if (! output.capturePath.empty()) {
+        unlink(output.capturePath.c_str());
+        capture.setPath(output.capturePath);
+    }
+
+    if (! output.documentDirectory.empty())
+        createDirectory(output.documentDirectory);
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    uint64_t start = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+
+    /*Selects are chosen with their own engine , so the documents don't depend on -q*/
+    std::mt19937_64 selects {0x5E1EC7};
+
+    long long duplicates = 0;
+    long long selectCount = 0;
+    long long bytes = 0;
+
+    for (long long i = 0; i < output.count; i++) {
+        std::string request;
+
+        if (output.selectRatio > 0 && capture.isRecording() &&
+            (selects() >> 11) / 9007199254740992.0 < output.selectRatio) {
+            request = generator.randomSelectRequest();
+            selectCount++;
+        } else {
+            bool duplicate;
+            request = generator.nextDocument(duplicate);
+            duplicates += duplicate;
+
+            if (! output.documentDirectory.empty()) {
+                char name[32];
+                snprintf(name, sizeof(name), "/%08lld.xml", i);
+                writeFile(output.documentDirectory + name, request);
+            }
+        }
+        bytes += request.size();
+
+        if (capture.isRecording()) {
+            uint64_t offset = output.rate > 0 ? static_cast<uint64_t>(i * 1e6 / output.rate) : 0;
+            capture.recordAt(start + offset, static_cast<uint32_t>(i % output.connections + 1),
+                             XML::Compression::none, request.data(), request.size());
+        }
+
+        if (output.documentDirectory.empty() && ! capture.isRecording())
+            std::cout << request << "\n";
+    }
+
+    std::cerr << "Generated " << output.count << " requests (" << duplicates << " duplicates , "
+              << selectCount << " selects) , " << bytes << " bytes.\n";
+}
+
+int main(int argc, char *argv[])
+{
+    WorkloadShape shape;
+    WorkloadOutput output;
+    int opt;
+
+    try {
+        while ((opt = getopt(argc, argv, ":s:t:d:f:p:v:u:n:o:e:c:k:r:q:h")) != -1) {
+            switch (opt) {
+            case 's':
+                shape.seed = std::stoull(optarg);
+                break;
+            case 't':
+                shape.tables = std::stoi(optarg);
+                break;
+            case 'd':
+                shape.depth = std::stoi(optarg);
+                break;
+            case 'f':
+                shape.fanOut = std::stoi(optarg);
+                break;
+            case 'p':
+                shape.properties = std::stoi(optarg);
+                break;
+            case 'v':
+                shape.valueSize = std::stoi(optarg);
+                break;
+            case 'u':
+                shape.duplicateRatio = std::stod(optarg);
+                break;
+            case 'n':
+                output.count = std::stoll(optarg);
+                break;
+            case 'o':
+                output.documentDirectory = optarg;
+                break;
+            case 'e':
+                output.selectDirectory = optarg;
+                break;
+            case 'c':
+                output.capturePath = optarg;
+                break;
+            case 'k':
+                output.connections = std::max(1, std::stoi(optarg));
+                break;
+            case 'r':
+                output.rate = std::stod(optarg);
+                break;
+            case 'q':
+                output.selectRatio = std::stod(optarg);
+                break;
+            case 'h':
+                printHelp();
+                return 0;
+            case ':':
+                std::cout << "Error : Option needs a value \n\n";
+                printHelp();
+                return 1;
+            case '?':
+                std::cout << "UnKnown option \n";
+                printHelp();
+                return 1;
+            }
+        }
+
+        WorkloadGenerator generator {shape};
+
+        if (! output.selectDirectory.empty())
+            writeSelects(generator, output.selectDirectory);
+
+        writeRequests(generator, output);
+
+    } catch (const std::exception &e) {
+        std::cerr << "Error : " << e.what();
+        return 1;
+    }
+
+    return 0;
+}
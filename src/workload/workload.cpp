@@ -0,0 +1,178 @@
+#include "workload.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+
+/*Earlier documents kept for duplicates*/
+const size_t workloadHistorySize = 1024;
+
+/*Objects of a document (the main object and every nested one) , bounds depth and fan-out*/
+const long long workloadMaxObjects = 1000000;
+
+/*Characters of generated values , no character needs escaping in xml*/
+const char workloadAlphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+/* Throws if value is not in [min , max]*/
+static void checkRange(long long value, long long min, long long max, const std::string &name)
+{
+    if (value < min || value > max)
+        throw std::invalid_argument("Invalid " + name + ": " + std::to_string(value) +
+                                    " (allowed " + std::to_string(min) + " to " +
+                                    std::to_string(max) + ")\n");
+}
+
+/**
+ *
+ * Implementation for "WorkloadGenerator" class
+ *
+ */
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadShape &shape) :
+    shape {shape},
+    random {shape.seed},
+    documents {0}
+{
+    checkRange(shape.tables, 1, 10000, "tables");
+    checkRange(shape.depth, 0, 16, "depth");
+    checkRange(shape.fanOut, 1, 64, "fanOut");
+    checkRange(shape.properties, 0, 1000, "properties");
+    checkRange(shape.valueSize, 1, 1 << 20, "valueSize");
+
+    /*Every level has fanOut times the objects of the level above*/
+    long long objects = 1;
+    long long levelObjects = 1;
+    for (int level = 1; level <= shape.depth && objects <= workloadMaxObjects; level++) {
+        levelObjects *= shape.fanOut;
+        objects += levelObjects;
+    }
+
+    if (objects > workloadMaxObjects)
+        throw std::invalid_argument("Invalid depth (-d) and fanOut (-f): " +
+                                    std::to_string(shape.depth) + " and " +
+                                    std::to_string(shape.fanOut) +
+                                    " give more than " + std::to_string(workloadMaxObjects) +
+                                    " objects per document\n");
+
+    if (shape.duplicateRatio < 0 || shape.duplicateRatio > 1)
+        throw std::invalid_argument("Invalid duplicateRatio: " +
+                                    std::to_string(shape.duplicateRatio) + " (allowed 0 to 1)\n");
+
+    for (int table = 0; table < shape.tables; table++) {
+        std::string name = "t" + std::to_string(table);
+        tableNames.push_back(name);
+
+        for (int level = 1; level <= shape.depth; level++)
+            tableNames.push_back(name + "_" + std::to_string(level));
+    }
+}
+
+/*
+ * Random numbers are taken from the raw output of the engine (not from
+ * distributions , which differ between standard libraries) , so a seed gives the
+ * same documents everywhere.
+ */
+std::string WorkloadGenerator::nextDocument(bool &duplicate)
+{
+    duplicate = false;
+
+    if (! history.empty() && shape.duplicateRatio > 0 &&
+        (random() >> 11) / 9007199254740992.0 < shape.duplicateRatio) {
+        duplicate = true;
+        return history[random() % history.size()];
+    }
+
+    std::string mainTable = "t" + std::to_string(documents % shape.tables);
+    documents++;
+
+    std::string document = "<root>";
+    appendObject(document, mainTable, 0, true);
+    document += "</root>";
+
+    history.push_back(document);
+    if (history.size() > workloadHistorySize)
+        history.pop_front();
+
+    return document;
+}
+
+std::string WorkloadGenerator::nextDocument()
+{
+    bool duplicate;
+    return nextDocument(duplicate);
+}
+
+std::string WorkloadGenerator::selectRequest(const std::string &table, const std::string &format)
+{
+    std::string request = "<request><operation type=\"select\"";
+    if (format != "xml")
+        request += " format=\"" + format + "\"";
+
+    if (table.empty())
+        return request + "/></request>";
+
+    return request + "><table>" + table + "</table></operation></request>";
+}
+
+std::string WorkloadGenerator::randomSelectRequest(const std::string &format)
+{
+    return selectRequest(tableNames[random() % tableNames.size()], format);
+}
+
+const std::vector<std::string> &WorkloadGenerator::getTableNames() const
+{
+    return tableNames;
+}
+
+/* Nested objects are named after the main table and their level (t0_1 , t0_2 , ...).*/
+void WorkloadGenerator::appendObject(std::string &document, const std::string &name, int level,
+                                     bool withUuid)
+{
+    document += "<" + name + ">";
+
+    if (withUuid)
+        document += "<uuid>" + randomUuid() + "</uuid>";
+
+    for (int property = 0; property < shape.properties; property++) {
+        std::string propertyName = "p" + std::to_string(property);
+
+        document += "<" + propertyName + ">";
+        appendValue(document);
+        document += "</" + propertyName + ">";
+    }
+
+    if (level < shape.depth) {
+        std::string childName = (level == 0 ? name : name.substr(0, name.rfind('_'))) + "_" +
+                                std::to_string(level + 1);
+
+        for (int child = 0; child < shape.fanOut; child++)
+            appendObject(document, childName, level + 1, false);
+    }
+
+    document += "</" + name + ">";
+}
+
+void WorkloadGenerator::appendValue(std::string &document)
+{
+    const size_t alphabetSize = sizeof(workloadAlphabet) - 1;
+
+    for (int i = 0; i < shape.valueSize; i++)
+        document.push_back(workloadAlphabet[random() % alphabetSize]);
+}
+
+std::string WorkloadGenerator::randomUuid()
+{
+    uint64_t high = random();
+    uint64_t low = random();
+
+    /*Version 4 and variant bits*/
+    high = (high & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL;
+    low = (low & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+
+    char uuid[37];
+    snprintf(uuid, sizeof(uuid), "%08x-%04x-%04x-%04x-%012llx",
+             static_cast<unsigned>(high >> 32), static_cast<unsigned>((high >> 16) & 0xFFFF),
+             static_cast<unsigned>(high & 0xFFFF), static_cast<unsigned>(low >> 48),
+             static_cast<unsigned long long>(low & 0xFFFFFFFFFFFFULL));
+
+    return uuid;
+}